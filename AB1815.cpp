@@ -19,15 +19,34 @@
 
 
 #include "AB1815.h"
-#include "SPI.h"
 #include "stdarg.h"
 
-AB1815::AB1815(uint16_t cs_pin) {
-  this->cs_pin = cs_pin;
-  pinMode(cs_pin, OUTPUT);
-  pinMode(SS, OUTPUT);
-  digitalWrite(cs_pin, HIGH);
-  SPI.begin();
+#ifdef AB1815_HAS_CHRONO
+AB1815* ab1815_clock::source = NULL;
+#endif
+
+#if defined(ESP32)
+portMUX_TYPE ab1815_queue_mux = portMUX_INITIALIZER_UNLOCKED;
+#elif defined(AB1815_QUEUE_MUTEX)
+std::mutex ab1815_queue_mutex;
+#endif
+
+AB1815::AB1815(uint16_t cs_pin) : transport(cs_pin) {
+  this->cache_enabled = false;
+  invalidate_cache();
+  this->async_head = 0;
+  this->async_count = 0;
+  this->time_anchor_valid = false;
+  set_time_cache(0, 0);
+  this->watchdog_value = 0;
+  this->alarm_writes = 0;
+#ifdef AB1815_ENABLE_STATS
+  reset_stats();
+#endif
+#ifdef AB1815_LOCK_FREERTOS
+  this->worker = NULL;
+#endif
+  transport.begin();
   init();
 }
 
@@ -35,6 +54,10 @@ enum ab1815_status_e AB1815::init()
 {
   this->fields._12_24 = 0;
   this->fields.clk_source = 0;
+  this->fields.arst = 0;
+  this->fields.arst_known = 0;
+  this->fields.extension_ram_known = 0;
+  this->extension_ram = 0;
   enum ab1815_status_e status = get_id(&this->id);
   if (status == ab1815_status_e_OK)
   {
@@ -48,70 +71,780 @@ enum ab1815_status_e AB1815::init()
   return status;
 };
 
-void AB1815::spi_select_slave(bool select)
+void AB1815::set_cache_enabled(bool enabled)
 {
-  if (select)
+  if (!enabled)
   {
-    digitalWrite(cs_pin, LOW);
-  } else
+    invalidate_cache();
+  }
+  this->cache_enabled = enabled;
+}
+
+void AB1815::invalidate_cache()
+{
+  memset(this->cache_valid, 0, sizeof(this->cache_valid));
+}
+
+// The configuration key needed before a write to offset, 0 if none.
+uint8_t AB1815::configuration_key_for(uint8_t offset)
+{
+  switch (offset)
   {
-    digitalWrite(cs_pin, HIGH);
+    case AB1815_REG_OSCILLATOR_CONTROL:
+      return ab1815_oscillator_control;
+    case AB1815_REG_TRICKLE_CONTROL:
+    case AB1815_REG_BREF_CONTROL:
+    case AB1815_REG_AFCTRL:
+    case AB1815_REG_BATMODE_IO:
+    case AB1815_REG_OUTPUT_CONTROL:
+      return ab1815_reg_control;
+    default:
+      return 0;
   }
 }
 
-enum ab1815_status_e AB1815::read(uint8_t offset, uint8_t* buf, uint8_t length)
+// Registers which the chip updates by itself, or which have side effects
+// when written, must always go to the bus.
+bool AB1815::is_cacheable(uint8_t offset)
+{
+  if (offset < AB1815_CACHE_FIRST || offset > AB1815_CACHE_LAST)
+  {
+    return false;
+  }
+  // A write to a key protected register without the key is ignored by the
+  // chip, so the copy could hold a value that never got there.
+  if (configuration_key_for(offset) != 0)
+  {
+    return false;
+  }
+  switch (offset)
+  {
+    case AB1815_REG_SLEEP_CONTROL:
+    case AB1815_REG_COUNTDOWN_TIMER_CONTROL:
+    case AB1815_REG_COUNTDOWN_TIMER:
+    case AB1815_REG_OSCILLATOR_STATUS:
+    case AB1815_REG_CONFIGURATION_KEY:
+    case AB1815_REG_ANALOG_STATUS:
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool AB1815::cache_hit(uint8_t offset, uint8_t length)
+{
+  if (!this->cache_enabled || length == 0)
+  {
+    return false;
+  }
+  for (uint16_t reg = offset; reg < (uint16_t)offset + length; reg++)
+  {
+    if (!is_cacheable(reg))
+    {
+      return false;
+    }
+    uint8_t index = reg - AB1815_CACHE_FIRST;
+    if (!(this->cache_valid[index / 8] & (1 << (index % 8))))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void AB1815::cache_store(uint8_t offset, uint8_t* buf, uint8_t length)
 {
-  uint8_t address = AB1815_SPI_READ(offset);
-  enum ab1815_status_e ret_code = ab1815_status_e_OK;
-  SPI.beginTransaction(spiSettings);
-  spi_select_slave(true);
-  SPI.transfer(address);
-  uint8_t val = 0;
+  if (!this->cache_enabled)
+  {
+    return;
+  }
   for (uint16_t i = 0; i < length; i++)
   {
-    val = SPI.transfer(0);
-    buf[i] = val;
+    uint16_t reg = offset + i;
+    if (is_cacheable(reg))
+    {
+      uint8_t index = reg - AB1815_CACHE_FIRST;
+      this->cache[index] = buf[i];
+      this->cache_valid[index / 8] |= (1 << (index % 8));
+    }
+  }
+}
+
+// Remember ARST, the watchdog and the RAM bank whenever control1, 0x1B or
+// 0x3F go over the bus
+void AB1815::track_registers(uint8_t offset, uint8_t* buf, uint8_t length)
+{
+  if (offset <= AB1815_REG_CONTROL1 && AB1815_REG_CONTROL1 < (uint16_t)offset + length)
+  {
+    control1_t control1;
+    control1.value = buf[AB1815_REG_CONTROL1 - offset];
+    this->fields.arst = control1.fields.ARST;
+    this->fields.arst_known = 1;
+  }
+  if (offset <= AB1815_REG_WATCHDOG_TIMER && AB1815_REG_WATCHDOG_TIMER < (uint16_t)offset + length)
+  {
+    this->watchdog_value = buf[AB1815_REG_WATCHDOG_TIMER - offset];
+  }
+  if (offset <= AB1815_EXTENTION_RAM && AB1815_EXTENTION_RAM < (uint16_t)offset + length)
+  {
+    this->extension_ram = buf[AB1815_EXTENTION_RAM - offset];
+    this->fields.extension_ram_known = 1;
+  }
+}
+
+enum ab1815_status_e AB1815::read(uint8_t offset, uint8_t* buf, uint8_t length)
+{
+  AB1815_BUS_GUARD();
+  if (cache_hit(offset, length))
+  {
+    memcpy(buf, &this->cache[offset - AB1815_CACHE_FIRST], length);
+#ifdef AB1815_ENABLE_STATS
+    this->bus_stats.cache_hits++;
+#endif
+    return ab1815_status_e_OK;
+  }
+
+#ifdef AB1815_ENABLE_STATS
+  uint32_t started = micros();
+#endif
+  if (!transport.read(offset, buf, length))
+  {
+    return ab1815_status_e_ERROR;
   }
-  ret_code = ab1815_status_e_OK;
-  spi_select_slave(false);
-  SPI.endTransaction();
-  return ret_code;
+#ifdef AB1815_ENABLE_STATS
+  record_transfer(this->bus_stats.reads, offset, micros() - started);
+  this->bus_stats.bytes_read += length;
+#endif
+
+  cache_store(offset, buf, length);
+  track_registers(offset, buf, length);
+  return ab1815_status_e_OK;
 };
 
 enum ab1815_status_e AB1815::write(uint8_t offset, uint8_t* buf, uint8_t length)
 {
+  AB1815_BUS_GUARD();
+#ifdef AB1815_ENABLE_STATS
+  uint32_t started = micros();
+#endif
+  if (!transport.write(offset, buf, length))
+  {
+    return ab1815_status_e_ERROR;
+  }
+#ifdef AB1815_ENABLE_STATS
+  record_transfer(this->bus_stats.writes, offset, micros() - started);
+  this->bus_stats.bytes_written += length;
+#endif
+
+  cache_store(offset, buf, length);
+  track_registers(offset, buf, length);
+  if (offset < AB1815_REG_ALARM_HUNDREDTHS)
+  {
+    // The time was changed, the extrapolated clock has to resync
+    this->time_anchor_valid = false;
+  }
+  if ((offset < AB1815_REG_STATUS && AB1815_REG_ALARM_HUNDREDTHS < (uint16_t)offset + length) ||
+      (offset <= AB1815_REG_COUNTDOWN_TIMER_CONTROL && AB1815_REG_COUNTDOWN_TIMER_CONTROL < (uint16_t)offset + length))
+  {
+    this->alarm_writes++;
+  }
+  return ab1815_status_e_OK;
+};
+
+enum ab1815_status_e AB1815::commit(ab1815_write_batch_t* batch)
+{
+  AB1815_BUS_GUARD();
+  uint8_t offset = 0;
+  while (offset < AB1815_BATCH_LENGTH)
+  {
+    if (!batch->is_pending(offset))
+    {
+      offset++;
+      continue;
+    }
 
-  uint8_t address = AB1815_SPI_WRITE(offset);
-  enum ab1815_status_e ret_code = ab1815_status_e_OK;
+    // The key is cleared by the chip after the protected register is
+    // written, so protected registers never share a burst.
+    uint8_t key = configuration_key_for(offset);
+    if (key != 0)
+    {
+      if (set_configuration_key((configuration_key_e)key) != ab1815_status_e_OK ||
+          write(offset, &batch->values[offset], 1) != ab1815_status_e_OK)
+      {
+        return ab1815_status_e_ERROR;
+      }
+      offset++;
+      continue;
+    }
+
+    uint8_t end = offset + 1;
+    while (batch->is_pending(end) && configuration_key_for(end) == 0)
+    {
+      end++;
+    }
+    if (write(offset, &batch->values[offset], end - offset) != ab1815_status_e_OK)
+    {
+      return ab1815_status_e_ERROR;
+    }
+    offset = end;
+  }
+  batch->clear();
+  return ab1815_status_e_OK;
+}
 
-  SPI.beginTransaction(spiSettings);
-  spi_select_slave(true);
+// Configuration registers that restore_image() writes back
+bool AB1815::is_restorable(uint8_t offset)
+{
+  if (offset >= AB1815_REG_ALARM_HUNDREDTHS && offset < AB1815_REG_STATUS)
+  {
+    return true;
+  }
+  switch (offset)
+  {
+    case AB1815_REG_CONTROL1:
+    case AB1815_REG_CONTROL2:
+    case AB1815_REG_INTERRUPT_MASK:
+    case AB1815_REG_SQW:
+    case AB1815_REG_CAL_XT:
+    case AB1815_REG_CAL_RC_HI:
+    case AB1815_REG_CAL_RC_LOW:
+    case AB1815_REG_SLEEP_CONTROL:
+    case AB1815_REG_COUNTDOWN_TIMER_CONTROL:
+    case AB1815_REG_COUNTDOWN_TIMER_INITIAL:
+    case AB1815_REG_WATCHDOG_TIMER:
+    case AB1815_REG_OSCILLATOR_CONTROL:
+    case AB1815_REG_TRICKLE_CONTROL:
+    case AB1815_REG_BREF_CONTROL:
+    case AB1815_REG_AFCTRL:
+    case AB1815_REG_BATMODE_IO:
+    case AB1815_REG_OUTPUT_CONTROL:
+    case AB1815_EXTENTION_RAM:
+      return true;
+    default:
+      return false;
+  }
+}
 
-  SPI.transfer(address);
-  for (uint16_t i = 0; i < length; i++)
+enum ab1815_status_e AB1815::save_image(ab1815_image_t* image)
+{
+  AB1815_BUS_GUARD();
+  uint8_t* registers = image->registers;
+  if (this->fields.arst_known && !this->fields.arst)
   {
-    SPI.transfer(buf[i]);
+    return read(AB1815_REG_TIME_HUNDREDTHS, registers, AB1815_BATCH_LENGTH);
   }
 
-  spi_select_slave(false);
-  SPI.endTransaction();
-  return ret_code;
-};
+  // Reading the status register would clear its flags
+  registers[AB1815_REG_STATUS] = 0;
+  if (read(AB1815_REG_TIME_HUNDREDTHS, registers, AB1815_REG_STATUS) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  return read(AB1815_REG_CONTROL1, &registers[AB1815_REG_CONTROL1], AB1815_BATCH_LENGTH - AB1815_REG_CONTROL1);
+}
+
+enum ab1815_status_e AB1815::restore_image(const ab1815_image_t* image)
+{
+  AB1815_BUS_GUARD();
+  ab1815_image_t current;
+  ab1815_write_batch_t batch;
+  if (save_image(&current) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  batch.clear();
+  int16_t last = -1;
+  for (uint8_t offset = 0; offset < AB1815_BATCH_LENGTH; offset++)
+  {
+    if (!is_restorable(offset))
+    {
+      continue;
+    }
+    uint8_t value = image->registers[offset];
+    uint8_t present = current.registers[offset];
+    if (offset == AB1815_REG_SLEEP_CONTROL)
+    {
+      // Never put the chip to sleep, SLST is only meaningful on read
+      value &= ~0x88;
+      present &= ~0x88;
+    }
+    if (value == present)
+    {
+      continue;
+    }
+
+    // Bridge a short run of unchanged registers so both end up in one burst.
+    // Registers which restart something when written are never bridged.
+    if (last >= 0 && configuration_key_for(offset) == 0 && configuration_key_for(last) == 0 &&
+        offset - last - 1 <= AB1815_IMAGE_MAX_GAP)
+    {
+      bool bridge = true;
+      for (uint8_t gap = last + 1; gap < offset; gap++)
+      {
+        if (!is_restorable(gap) || configuration_key_for(gap) != 0 ||
+            gap == AB1815_REG_SLEEP_CONTROL || gap == AB1815_REG_WATCHDOG_TIMER)
+        {
+          bridge = false;
+        }
+      }
+      for (uint8_t gap = last + 1; bridge && gap < offset; gap++)
+      {
+        batch.add(gap, current.registers[gap]);
+      }
+    }
+    batch.add(offset, value);
+    last = offset;
+  }
+  return commit(&batch);
+}
+
+uint32_t AB1815::fingerprint(const ab1815_write_batch_t* batch)
+{
+  uint32_t hash = 2166136261UL;
+  for (uint8_t offset = 0; offset < AB1815_BATCH_LENGTH; offset++)
+  {
+    if (batch->is_pending(offset))
+    {
+      hash = (hash ^ offset) * 16777619UL;
+      hash = (hash ^ batch->values[offset]) * 16777619UL;
+    }
+  }
+  return hash;
+}
+
+enum ab1815_status_e AB1815::apply_if_changed(ab1815_write_batch_t* batch, bool* applied)
+{
+  AB1815_BUS_GUARD();
+  uint32_t hash = fingerprint(batch);
+  uint8_t stored[4];
+  if (applied != NULL)
+  {
+    *applied = false;
+  }
+  if (read_ram(AB1815_FINGERPRINT_OFFSET, stored, sizeof(stored)) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  if (((uint32_t)stored[0] | (uint32_t)stored[1] << 8 | (uint32_t)stored[2] << 16 | (uint32_t)stored[3] << 24) == hash)
+  {
+    batch->clear();
+    return ab1815_status_e_OK;
+  }
+
+  if (commit(batch) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  if (applied != NULL)
+  {
+    *applied = true;
+  }
+  stored[0] = hash;
+  stored[1] = hash >> 8;
+  stored[2] = hash >> 16;
+  stored[3] = hash >> 24;
+  return write_ram(AB1815_FINGERPRINT_OFFSET, stored, sizeof(stored));
+}
+
+enum ab1815_status_e AB1815::clear_fingerprint()
+{
+  // A batch hashes to 0 only by a 1 in 2^32 chance
+  uint8_t stored[4] = {0, 0, 0, 0};
+  return write_ram(AB1815_FINGERPRINT_OFFSET, stored, sizeof(stored));
+}
+
+enum ab1815_status_e AB1815::select_ram_bank(uint8_t bank)
+{
+  extension_ram_t extension_ram;
+  // Another user or an earlier boot may have left any bank selected, and the
+  // other bits of 0x3F are configuration which has to be preserved.
+  if (!this->fields.extension_ram_known && get_extension_ram(&extension_ram) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  extension_ram.value = this->extension_ram;
+  if (extension_ram.fields.XADS == bank)
+  {
+    return ab1815_status_e_OK;
+  }
+  extension_ram.fields.XADS = bank;
+  return set_extension_ram(&extension_ram);
+}
+
+enum ab1815_status_e AB1815::ram_transfer(uint8_t address, uint8_t* buf, uint16_t length, bool write_ram)
+{
+  AB1815_BUS_GUARD();
+  enum ab1815_status_e result = ab1815_status_e_OK;
+  if (address + length > 0x100)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  while (length > 0 && result == ab1815_status_e_OK)
+  {
+    uint8_t offset = address % AB1815_RAM_LENGTH;
+    uint8_t chunk = AB1815_RAM_LENGTH - offset;
+    if (chunk > length)
+    {
+      chunk = length;
+    }
+    result = select_ram_bank(address / AB1815_RAM_LENGTH);
+    if (result == ab1815_status_e_OK)
+    {
+      if (write_ram)
+      {
+        result = write(AB1815_RAM + offset, buf, chunk);
+      } else
+      {
+        result = read(AB1815_RAM + offset, buf, chunk);
+      }
+    }
+    address += chunk;
+    buf += chunk;
+    length -= chunk;
+  }
+  // Leave bank 0 selected, the fingerprint and direct RAM users expect it
+  if (select_ram_bank(0) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  return result;
+}
+
+enum ab1815_status_e AB1815::read_ram(uint8_t address, uint8_t* buf, uint16_t length)
+{
+  return ram_transfer(address, buf, length, false);
+}
+
+enum ab1815_status_e AB1815::write_ram(uint8_t address, uint8_t* buf, uint16_t length)
+{
+  return ram_transfer(address, buf, length, true);
+}
+
+bool AB1815::enqueue(ab1815_async_request_t* request)
+{
+  bool queued = false;
+  AB1815_QUEUE_ENTER();
+  if (this->async_count < AB1815_ASYNC_QUEUE_LENGTH)
+  {
+    uint8_t tail = (this->async_head + this->async_count) % AB1815_ASYNC_QUEUE_LENGTH;
+    this->async_queue[tail] = *request;
+    this->async_count++;
+    queued = true;
+  }
+  AB1815_QUEUE_EXIT();
+  return queued;
+}
+
+enum ab1815_status_e AB1815::submit(ab1815_async_request_t* request)
+{
+  if (!enqueue(request))
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+#ifdef AB1815_LOCK_FREERTOS
+  if (this->worker != NULL)
+  {
+    xTaskNotifyGive(this->worker);
+  }
+#endif
+  return ab1815_status_e_OK;
+}
+
+#ifdef AB1815_ENABLE_BUS_LOCK
+enum ab1815_status_e AB1815::submit_from_isr(ab1815_async_request_t* request)
+{
+  if (!enqueue(request))
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+#ifdef AB1815_LOCK_FREERTOS
+  if (this->worker != NULL)
+  {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(this->worker, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+#endif
+  return ab1815_status_e_OK;
+}
+
+#ifdef AB1815_LOCK_FREERTOS
+void AB1815::worker_task(void* clock)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (((AB1815*)clock)->process())
+    {
+    }
+  }
+}
+
+enum ab1815_status_e AB1815::start_worker(UBaseType_t priority, uint32_t stack_size)
+{
+  if (this->worker != NULL)
+  {
+    return ab1815_status_e_OK;
+  }
+  if (xTaskCreate(&AB1815::worker_task, "ab1815", stack_size, this, priority, &this->worker) != pdPASS)
+  {
+    this->worker = NULL;
+    return ab1815_status_e_ERROR;
+  }
+  return ab1815_status_e_OK;
+}
+#endif
+#endif
+
+enum ab1815_status_e AB1815::read_async(uint8_t offset, uint8_t* buf, uint8_t length, ab1815_callback_t callback, void* context)
+{
+  ab1815_async_request_t request = {ab1815_async_read, offset, length, ab1815_alarm_repeat_alarm_disabled, buf, callback, context};
+  return submit(&request);
+}
+
+enum ab1815_status_e AB1815::write_async(uint8_t offset, uint8_t* buf, uint8_t length, ab1815_callback_t callback, void* context)
+{
+  ab1815_async_request_t request = {ab1815_async_write, offset, length, ab1815_alarm_repeat_alarm_disabled, buf, callback, context};
+  return submit(&request);
+}
+
+enum ab1815_status_e AB1815::get_time_async(ab1815_tmElements_t* time, ab1815_callback_t callback, void* context)
+{
+  ab1815_async_request_t request = {ab1815_async_get_time, 0, 0, ab1815_alarm_repeat_alarm_disabled, time, callback, context};
+  return submit(&request);
+}
+
+enum ab1815_status_e AB1815::set_alarm_async(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode alarm_mode, ab1815_callback_t callback, void* context)
+{
+  ab1815_async_request_t request = {ab1815_async_set_alarm, 0, 0, alarm_mode, time, callback, context};
+  return submit(&request);
+}
+
+bool AB1815::process()
+{
+  // Dequeue before running so that the callback may submit follow up requests
+  ab1815_async_request_t request;
+  bool queued = false;
+  AB1815_QUEUE_ENTER();
+  if (this->async_count != 0)
+  {
+    request = this->async_queue[this->async_head];
+    this->async_head = (this->async_head + 1) % AB1815_ASYNC_QUEUE_LENGTH;
+    this->async_count--;
+    queued = true;
+  }
+  AB1815_QUEUE_EXIT();
+  if (!queued)
+  {
+    return false;
+  }
+
+  enum ab1815_status_e status = ab1815_status_e_ERROR;
+  switch (request.op)
+  {
+    case ab1815_async_read:
+      status = read(request.offset, (uint8_t*)request.data, request.length);
+      break;
+    case ab1815_async_write:
+      status = write(request.offset, (uint8_t*)request.data, request.length);
+      break;
+    case ab1815_async_get_time:
+      status = get_time((ab1815_tmElements_t*)request.data);
+      break;
+    case ab1815_async_set_alarm:
+      status = set_alarm((ab1815_tmElements_t*)request.data, request.alarm_mode);
+      break;
+  }
+
+  if (request.callback != NULL)
+  {
+    request.callback(status, request.context);
+  }
+  return true;
+}
+
+uint8_t AB1815::pending_async()
+{
+  return this->async_count;
+}
+
+void AB1815::set_time_cache(uint32_t resync_interval_ms, uint32_t drift_tolerance_ms)
+{
+  if (resync_interval_ms > AB1815_TIME_CACHE_MAX_INTERVAL_MS)
+  {
+    resync_interval_ms = AB1815_TIME_CACHE_MAX_INTERVAL_MS;
+  }
+  this->time_cache_interval_ms = resync_interval_ms;
+  this->time_cache_tolerance_ms = drift_tolerance_ms;
+  this->time_cache_effective_ms = resync_interval_ms;
+  this->time_anchor_valid = false;
+  memset(&this->time_cache_stats, 0, sizeof(this->time_cache_stats));
+}
+
+void AB1815::invalidate_time_cache()
+{
+  this->time_anchor_valid = false;
+}
+
+ab1815_time_cache_stats_t* AB1815::get_time_cache_stats()
+{
+  return &this->time_cache_stats;
+}
+
+// Read the RTC and anchor the extrapolated clock to it
+time_t AB1815::resync_time()
+{
+  time_t now;
+  uint8_t hundredths;
+  if (read_epoch(&now, &hundredths) != ab1815_status_e_OK)
+  {
+    this->time_anchor_valid = false;
+    return 0;
+  }
+  uint32_t now_us = micros();
+  uint32_t now_ms = millis();
+
+  this->time_cache_stats.resyncs++;
+  // The anchor is up to a second older than time_anchor_ms. When get() has
+  // not been called for longer than micros() takes to wrap, the elapsed
+  // micros() are meaningless and there is nothing to compare against.
+  if (this->time_anchor_valid && now_ms - this->time_anchor_ms < AB1815_MICROS_WRAP_MS - 1000)
+  {
+    int32_t actual_ms = (int32_t)(now - this->time_anchor) * 1000 + hundredths * 10;
+    int32_t predicted_ms = (now_us - this->time_anchor_us) / 1000;
+    int32_t drift = actual_ms - predicted_ms;
+    int32_t magnitude = drift < 0 ? -drift : drift;
+
+    this->time_cache_stats.last_drift_ms = drift;
+    if (magnitude > this->time_cache_stats.max_drift_ms)
+    {
+      this->time_cache_stats.max_drift_ms = magnitude;
+    }
+    if ((uint32_t)magnitude > this->time_cache_tolerance_ms)
+    {
+      this->time_cache_stats.drift_exceeded++;
+      if (this->time_cache_effective_ms > 1)
+      {
+        this->time_cache_effective_ms /= 2;
+      }
+    } else if (this->time_cache_effective_ms < this->time_cache_interval_ms)
+    {
+      this->time_cache_effective_ms *= 2;
+      if (this->time_cache_effective_ms > this->time_cache_interval_ms)
+      {
+        this->time_cache_effective_ms = this->time_cache_interval_ms;
+      }
+    }
+  }
+
+  // Shift the anchor back by the hundredths so it marks the whole second
+  this->time_anchor = now;
+  this->time_anchor_us = now_us - (uint32_t)hundredths * 10000;
+  this->time_anchor_ms = now_ms;
+  this->time_anchor_valid = true;
+  return now;
+}
+
+int32_t ab1815_days_from_civil(int16_t year, uint8_t month, uint8_t day)
+{
+  // Years start in March so that the leap day is the last day of the year
+  int32_t y = year - (month <= 2);
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = y - era * 400;
+  uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+void ab1815_civil_from_days(int32_t days, int16_t* year, uint8_t* month, uint8_t* day)
+{
+  days += 719468;
+  int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+  uint32_t doe = days - era * 146097;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  *day = doy - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = yoe + era * 400 + (*month <= 2);
+}
+
+time_t ab1815_block_to_epoch(const uint8_t* bin)
+{
+  int32_t days = ab1815_days_from_civil(2000 + bin[6], bin[5], bin[4]);
+  return (time_t)days * SECS_PER_DAY + bin[3] * 3600L + bin[2] * 60 + bin[1];
+}
+
+void ab1815_epoch_to_block(time_t epoch, uint8_t* bin)
+{
+  int32_t days = epoch / SECS_PER_DAY;
+  uint32_t seconds = epoch - (time_t)days * SECS_PER_DAY;
+  int16_t year;
+
+  bin[0] = 0;
+  bin[1] = seconds % 60;
+  bin[2] = (seconds / 60) % 60;
+  bin[3] = seconds / 3600;
+  ab1815_civil_from_days(days, &year, &bin[5], &bin[4]);
+  bin[6] = year - 2000;
+  // 1970-01-01 was a Thursday, TimeLib counts weekdays from Sunday = 1
+  bin[7] = (days + 4) % 7 + 1;
+}
+
+enum ab1815_status_e AB1815::read_epoch(time_t* epoch, uint8_t* hundredths)
+{
+  uint8_t buffer[8];
+  uint8_t bin[8];
+  if (read(AB1815_REG_TIME_HUNDREDTHS, buffer, 8) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  ab1815_bcd2bin_block(buffer, bin, AB1815_TIME_BCD_MASK);
+  *epoch = ab1815_block_to_epoch(bin);
+  *hundredths = bin[0];
+  return ab1815_status_e_OK;
+}
 
 // 0x00
 time_t AB1815::get()
 {
-  ab1815_tmElements_t tm;
-  get_time(&tm);
-  return makeTime(tm);
+  if (this->time_cache_interval_ms == 0)
+  {
+    time_t epoch = 0;
+    uint8_t hundredths;
+    read_epoch(&epoch, &hundredths);
+    return epoch;
+  }
+
+  // millis() guards the interval, micros() alone would alias after it wraps
+  if (this->time_anchor_valid && millis() - this->time_anchor_ms < this->time_cache_effective_ms)
+  {
+    this->time_cache_stats.hits++;
+    return this->time_anchor + (micros() - this->time_anchor_us) / 1000000;
+  }
+  return resync_time();
+}
+
+// 0x00
+uint64_t AB1815::get_ms()
+{
+  time_t epoch = 0;
+  uint8_t hundredths = 0;
+  read_epoch(&epoch, &hundredths);
+  return (uint64_t)epoch * 1000 + hundredths * 10;
 }
 
 // 0x00
 void AB1815::set(time_t time)
 {
-  ab1815_tmElements_t tm;
-  breakTime(time, tm);
-  set_time(&tm);
+  uint8_t bin[8];
+  uint8_t buffer[8];
+  ab1815_epoch_to_block(time, bin);
+  ab1815_bin2bcd_block(bin, buffer);
+  write(AB1815_REG_TIME_HUNDREDTHS, buffer, 8);
 }
 
 // 0x00
@@ -120,18 +853,20 @@ enum ab1815_status_e AB1815::get_time(ab1815_tmElements_t* time)
   enum ab1815_status_e to_ret = ab1815_status_e_ERROR;
   size_t length = (AB1815_REG_ALARM_HUNDREDTHS - AB1815_REG_TIME_HUNDREDTHS) ;
   uint8_t buffer[length];
+  uint8_t bin[8];
   memset(buffer, 0, length);
   if (read(AB1815_REG_TIME_HUNDREDTHS, buffer, length) == ab1815_status_e_OK)
   {
     to_ret = ab1815_status_e_OK;
-    time->Hundredth = bcd2bin(buffer[0]);
-    time->Second = bcd2bin(0x7F & buffer[1]);
-    time->Minute = bcd2bin(0x7F & buffer[2]);
-    time->Hour = bcd2bin(0x3F & buffer[3]);
-    time->Day = bcd2bin(0x3F & buffer[4]);
-    time->Month = bcd2bin(0x1F & buffer[5]);
-    time->Year = y2kYearToTm(bcd2bin(buffer[6]));
-    time->Wday = bcd2bin(0x07 & buffer[7]);
+    ab1815_bcd2bin_block(buffer, bin, AB1815_TIME_BCD_MASK);
+    time->Hundredth = bin[0];
+    time->Second = bin[1];
+    time->Minute = bin[2];
+    time->Hour = bin[3];
+    time->Day = bin[4];
+    time->Month = bin[5];
+    time->Year = y2kYearToTm(bin[6]);
+    time->Wday = bin[7];
   }
   return to_ret;
 }
@@ -143,15 +878,9 @@ enum ab1815_status_e AB1815::set_time(ab1815_tmElements_t* time)
   uint8_t buffer[length];
   enum ab1815_status_e result = ab1815_status_e_ERROR;
 
-  memset(buffer, 0, length);
-  buffer[0] = bin2bcd(time->Hundredth);
-  buffer[1] = bin2bcd(0x7F & time->Second);
-  buffer[2] = bin2bcd(0x7F & time->Minute);
-  buffer[3] = bin2bcd(0x3F & time->Hour);
-  buffer[4] = bin2bcd(0x3F & time->Day);
-  buffer[5] = bin2bcd(0x1F & time->Month);
-  buffer[6] = bin2bcd(tmYearToY2k(time->Year));
-  buffer[7] = bin2bcd(0x07 & time->Wday);
+  uint8_t bin[8] = {time->Hundredth, time->Second, time->Minute, time->Hour,
+                    time->Day, time->Month, (uint8_t)tmYearToY2k(time->Year), time->Wday};
+  ab1815_bin2bcd_block(bin, buffer);
 
   if (write(AB1815_REG_TIME_HUNDREDTHS, buffer, length) == ab1815_status_e_OK)
   {
@@ -171,10 +900,12 @@ enum ab1815_status_e AB1815::clear_hundrdeds()
 // 0x08
 enum ab1815_status_e AB1815::get_alarm(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode* alarm_mode)
 {
+  AB1815_BUS_GUARD();
   enum ab1815_status_e to_ret = ab1815_status_e_ERROR;
   size_t length = AB1815_REG_STATUS - AB1815_REG_ALARM_HUNDREDTHS ;
-  uint8_t buffer[length];
-  memset(buffer, 0, length);
+  uint8_t buffer[8];
+  uint8_t bin[8];
+  memset(buffer, 0, sizeof(buffer));
   struct countdown_control_t cd_reg;
   uint32_t* val = (uint32_t*)alarm_mode;
 
@@ -183,13 +914,14 @@ enum ab1815_status_e AB1815::get_alarm(ab1815_tmElements_t* time, enum ab1815_al
     if (read(AB1815_REG_ALARM_HUNDREDTHS, buffer, length) == ab1815_status_e_OK)
     {
       to_ret = ab1815_status_e_OK;
-      time->Hundredth = bcd2bin(buffer[0]);
-      time->Second = bcd2bin(0x7F & buffer[1]);
-      time->Minute = bcd2bin(0x7F & buffer[2]);
-      time->Hour = bcd2bin(0x3F & buffer[3]);
-      time->Day = bcd2bin(0x3F & buffer[4]);
-      time->Month = bcd2bin(0x1F & buffer[5]);
-      time->Wday = bcd2bin(0x07 & buffer[6]);
+      ab1815_bcd2bin_block(buffer, bin, AB1815_ALARM_BCD_MASK);
+      time->Hundredth = bin[0];
+      time->Second = bin[1];
+      time->Minute = bin[2];
+      time->Hour = bin[3];
+      time->Day = bin[4];
+      time->Month = bin[5];
+      time->Wday = bin[6];
     }
     *alarm_mode = (ab1815_alarm_repeat_mode)cd_reg.fields.RPT;
     if (cd_reg.fields.RPT == 7)
@@ -211,19 +943,15 @@ enum ab1815_status_e AB1815::get_alarm(ab1815_tmElements_t* time, enum ab1815_al
 // 0x08
 enum ab1815_status_e AB1815::set_alarm(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode alarm_mode)
 {
+  AB1815_BUS_GUARD();
   size_t length = AB1815_REG_STATUS - AB1815_REG_ALARM_HUNDREDTHS;
-  uint8_t buffer[length];
+  uint8_t buffer[8];
   enum ab1815_status_e result = ab1815_status_e_ERROR;
   uint8_t repeat = alarm_mode;
 
-  memset(buffer, 0, length);
-  buffer[0] = bin2bcd(time->Hundredth);
-  buffer[1] = bin2bcd(0x7F & time->Second);
-  buffer[2] = bin2bcd(0x7F & time->Minute);
-  buffer[3] = bin2bcd(0x3F & time->Hour);
-  buffer[4] = bin2bcd(0x3F & time->Day);
-  buffer[5] = bin2bcd(0x1F & time->Month);
-  buffer[6] = bin2bcd(0x07 & time->Wday);
+  uint8_t bin[8] = {time->Hundredth, time->Second, time->Minute, time->Hour,
+                    time->Day, time->Month, time->Wday, 0};
+  ab1815_bin2bcd_block(bin, buffer);
 
   switch (alarm_mode)
   {
@@ -252,6 +980,11 @@ enum ab1815_status_e AB1815::set_alarm(ab1815_tmElements_t* time, enum ab1815_al
   return result;
 };
 
+uint8_t AB1815::get_alarm_writes()
+{
+  return this->alarm_writes;
+}
+
 // 0x0F - See also: ARST in Control1.
 //	If ARST is a 1, a read of the Status register will produce the current state of all
 //	the interrupt flags and then clear them
@@ -265,6 +998,54 @@ enum ab1815_status_e AB1815::get_status(status_t* status)
   return read(AB1815_REG_STATUS, &status->value, 1);
 };
 
+enum ab1815_status_e AB1815::get_status_auto_clear(bool* arst)
+{
+  if (!this->fields.arst_known)
+  {
+    control1_t control1;
+    if (get_control1(&control1) != ab1815_status_e_OK)
+    {
+      return ab1815_status_e_ERROR;
+    }
+  }
+  *arst = this->fields.arst;
+  return ab1815_status_e_OK;
+}
+
+enum ab1815_status_e AB1815::get_snapshot(ab1815_snapshot_t* snapshot)
+{
+  uint8_t buffer[AB1815_REG_STATUS + 1];
+  uint8_t bin[8];
+  if (read(AB1815_REG_TIME_HUNDREDTHS, buffer, sizeof(buffer)) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  ab1815_bcd2bin_block(buffer, bin, AB1815_TIME_BCD_MASK);
+  snapshot->epoch = ab1815_block_to_epoch(bin);
+  snapshot->time.Hundredth = bin[0];
+  snapshot->time.Second = bin[1];
+  snapshot->time.Minute = bin[2];
+  snapshot->time.Hour = bin[3];
+  snapshot->time.Day = bin[4];
+  snapshot->time.Month = bin[5];
+  snapshot->time.Year = y2kYearToTm(bin[6]);
+  snapshot->time.Wday = bin[7];
+
+  ab1815_bcd2bin_block(&buffer[AB1815_REG_ALARM_HUNDREDTHS], bin, AB1815_ALARM_BCD_MASK);
+  snapshot->alarm.Hundredth = bin[0];
+  snapshot->alarm.Second = bin[1];
+  snapshot->alarm.Minute = bin[2];
+  snapshot->alarm.Hour = bin[3];
+  snapshot->alarm.Day = bin[4];
+  snapshot->alarm.Month = bin[5];
+  snapshot->alarm.Year = 0;
+  snapshot->alarm.Wday = bin[6];
+
+  snapshot->status.value = buffer[AB1815_REG_STATUS];
+  return ab1815_status_e_OK;
+}
+
 // 0x10
 enum ab1815_status_e AB1815::set_control1(control1_t* control1)
 {
@@ -342,6 +1123,62 @@ enum ab1815_status_e AB1815::get_cal_rc_low(cal_rc_low_t* cal_rc_low)
   return read(AB1815_REG_CAL_RC_LOW, &cal_rc_low->OFFSETR, 1);
 }
 
+// 0x15 - 0x16
+int32_t AB1815::rc_error_ppm(uint32_t rtc_elapsed_ms, uint32_t reference_elapsed_ms)
+{
+  if (reference_elapsed_ms == 0)
+  {
+    return 0;
+  }
+  return ((int64_t)rtc_elapsed_ms - (int64_t)reference_elapsed_ms) * 1000000 / reference_elapsed_ms;
+}
+
+enum ab1815_status_e AB1815::plan_rc_calibration(int32_t error_ppm, cal_rc_hi_t* cal_rc_hi, cal_rc_low_t* cal_rc_low)
+{
+  // A fast clock needs a negative correction
+  int32_t adjust = -((int64_t)error_ppm * 1048576) / 1000000;
+  for (uint8_t cmdr = 0; cmdr < 4; cmdr++)
+  {
+    int32_t offset = adjust / (1 << cmdr);
+    if (offset >= -8192 && offset <= 8191)
+    {
+      cal_rc_hi->fields.CMDR = cmdr;
+      cal_rc_hi->fields.OFFSETR = (offset >> 8) & 0x3F;
+      cal_rc_low->OFFSETR = offset & 0xFF;
+      return ab1815_status_e_OK;
+    }
+  }
+  return ab1815_status_e_ERROR;
+}
+
+enum ab1815_status_e AB1815::calibrate_rc(int32_t error_ppm)
+{
+  cal_rc_hi_t cal_rc_hi;
+  cal_rc_low_t cal_rc_low;
+  if (plan_rc_calibration(error_ppm, &cal_rc_hi, &cal_rc_low) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  uint8_t buffer[2] = {cal_rc_hi.value, cal_rc_low.OFFSETR};
+  return write(AB1815_REG_CAL_RC_HI, buffer, sizeof(buffer));
+}
+
+enum ab1815_status_e AB1815::set_rc_policy(enum ab1815_rc_policy_e policy)
+{
+  AB1815_BUS_GUARD();
+  oscillator_control_t oscillator_control;
+  if (get_oscillator_control(&oscillator_control) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  if (oscillator_control.fields.ACAL == policy)
+  {
+    return ab1815_status_e_OK;
+  }
+  oscillator_control.fields.ACAL = policy;
+  return set_oscillator_control(&oscillator_control);
+}
+
 // 0x17 sleep_control_t
 enum ab1815_status_e AB1815::set_sleep_control(sleep_control_t* sleep_control)
 {
@@ -386,6 +1223,222 @@ enum ab1815_status_e AB1815::get_countdown_timer_initial_value(uint8_t* timer_va
   return read(AB1815_REG_COUNTDOWN_TIMER_INITIAL, timer_value, 1);
 }
 
+// 0x18 - 0x1A
+ab1815_timer_plan_t AB1815::plan_periodic_timer(uint32_t period_ms, bool rc_oscillator)
+{
+  // Timer ticks per minute for each TFS setting, slowest first
+  const uint32_t fastest = rc_oscillator ? 7680 : 245760;
+  const uint32_t ticks_per_minute[4] = {1, 60, 3840, fastest};
+  const enum countdown_timer_frequency_e frequency[4] = {
+    ab1815_countdown_1_60HZ, ab1815_countdown_1HZ, ab1815_countdown_64HZ, ab1815_countdown_4096HZ
+  };
+
+  ab1815_timer_plan_t best = {ab1815_countdown_1_60HZ, 0, 0};
+  uint64_t best_magnitude = UINT64_MAX;
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    uint64_t ticks = ((uint64_t)period_ms * ticks_per_minute[i] + 30000) / 60000;
+    if (ticks < 1)
+    {
+      ticks = 1;
+    }
+    if (ticks > 256)
+    {
+      ticks = 256;
+    }
+    int64_t actual_us = (int64_t)(ticks * 60000000ULL / ticks_per_minute[i]);
+    int64_t error = actual_us - (int64_t)period_ms * 1000;
+    uint64_t magnitude = error < 0 ? -error : error;
+    if (magnitude < best_magnitude)
+    {
+      best_magnitude = magnitude;
+      best.frequency = frequency[i];
+      best.initial_value = ticks - 1;
+      // Only periods beyond the 256 minute range saturate
+      best.error_us = error < INT32_MIN ? INT32_MIN : (error > INT32_MAX ? INT32_MAX : error);
+    }
+  }
+  return best;
+}
+
+enum ab1815_status_e AB1815::set_periodic_timer(uint32_t period_ms, bool repeat, bool pulse, ab1815_timer_plan_t* plan)
+{
+  if (period_ms == 0 || period_ms > AB1815_COUNTDOWN_MAX_MS)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  AB1815_BUS_GUARD();
+  oscillator_control_t oscillator_control;
+  countdown_control_t countdown_control;
+  if (get_oscillator_control(&oscillator_control) != ab1815_status_e_OK ||
+      get_countdown_control(&countdown_control) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  ab1815_timer_plan_t best = plan_periodic_timer(period_ms, oscillator_control.fields.OSEL);
+  if (plan != NULL)
+  {
+    *plan = best;
+  }
+
+  countdown_control.fields.TFS = best.frequency;
+  countdown_control.fields.TRPT = repeat;
+  countdown_control.fields.TM = pulse;
+  countdown_control.fields.TE = 1;
+
+  // Countdown control, countdown timer and initial value are contiguous
+  uint8_t buffer[3] = {countdown_control.value, best.initial_value, best.initial_value};
+  return write(AB1815_REG_COUNTDOWN_TIMER_CONTROL, buffer, sizeof(buffer));
+}
+
+enum ab1815_status_e AB1815::stop_periodic_timer()
+{
+  AB1815_BUS_GUARD();
+  countdown_control_t countdown_control;
+  if (get_countdown_control(&countdown_control) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  countdown_control.fields.TE = 0;
+  return set_countdown_control(&countdown_control);
+}
+
+// 0x17 - Sleep
+// image holds registers 0x00 up to at least last, as read from the chip
+enum ab1815_status_e AB1815::enter_sleep(uint8_t* image, uint8_t last, uint16_t shutdown_ms, bool assert_reset)
+{
+  if (shutdown_ms > AB1815_SLEEP_MAX_SHUTDOWN_MS)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  // millis()/micros() stop while the MCU is powered down, the extrapolated
+  // time would lag behind by the length of the sleep
+  this->time_anchor_valid = false;
+
+  // Keep only the century bit, every interrupt flag is cleared
+  status_t status;
+  status.value = image[AB1815_REG_STATUS];
+  status.value &= 0x80;
+  image[AB1815_REG_STATUS] = status.value;
+
+  // SLTO counts 7.8 ms periods, at least one so the read back below still
+  // happens before the interface is powered down
+  uint8_t slto = ((uint16_t)shutdown_ms * 10 + 77) / 78;
+  sleep_control_t sleep_control;
+  sleep_control.value = image[AB1815_REG_SLEEP_CONTROL];
+  sleep_control.fields.SLP = 0;
+  sleep_control.fields.SLTO = slto < 1 ? 1 : slto;
+  sleep_control.fields.SLRES = assert_reset;
+  image[AB1815_REG_SLEEP_CONTROL] = sleep_control.value;
+
+  if (write(AB1815_REG_ALARM_HUNDREDTHS, &image[AB1815_REG_ALARM_HUNDREDTHS], last - AB1815_REG_ALARM_HUNDREDTHS + 1) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  sleep_control.fields.SLP = 1;
+  if (set_sleep_control(&sleep_control) != ab1815_status_e_OK ||
+      get_sleep_control(&sleep_control) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  // The chip clears SLP straight away when it refuses to sleep
+  return sleep_control.fields.SLP ? ab1815_status_e_OK : ab1815_status_e_ERROR;
+}
+
+enum ab1815_status_e AB1815::sleep_on_alarm(uint8_t* image, time_t wake_at, uint16_t shutdown_ms, bool assert_reset)
+{
+  uint8_t bin[8];
+  uint8_t bcd[8];
+  ab1815_epoch_to_block(wake_at, bin);
+  // The alarm block has no year, weekday moves into its place
+  bin[6] = bin[7];
+  bin[7] = 0;
+  ab1815_bin2bcd_block(bin, bcd);
+  memcpy(&image[AB1815_REG_ALARM_HUNDREDTHS], bcd, AB1815_REG_STATUS - AB1815_REG_ALARM_HUNDREDTHS);
+
+  countdown_control_t countdown_control;
+  countdown_control.value = image[AB1815_REG_COUNTDOWN_TIMER_CONTROL];
+  countdown_control.fields.RPT = ab1815_alarm_repeat_once_per_year;
+  image[AB1815_REG_COUNTDOWN_TIMER_CONTROL] = countdown_control.value;
+
+  inturrupt_mask_t interrupt_mask;
+  interrupt_mask.value = image[AB1815_REG_INTERRUPT_MASK];
+  interrupt_mask.fields.AIE = 1;
+  image[AB1815_REG_INTERRUPT_MASK] = interrupt_mask.value;
+
+  return enter_sleep(image, AB1815_REG_COUNTDOWN_TIMER_CONTROL, shutdown_ms, assert_reset);
+}
+
+enum ab1815_status_e AB1815::sleep_until(time_t wake_at, uint16_t shutdown_ms, bool assert_reset)
+{
+  AB1815_BUS_GUARD();
+  uint8_t image[AB1815_REG_OSCILLATOR_CONTROL + 1];
+  uint8_t bin[8];
+  if (read(AB1815_REG_TIME_HUNDREDTHS, image, sizeof(image)) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  ab1815_bcd2bin_block(image, bin, AB1815_TIME_BCD_MASK);
+  if (wake_at <= ab1815_block_to_epoch(bin))
+  {
+    return ab1815_status_e_ERROR;
+  }
+  return sleep_on_alarm(image, wake_at, shutdown_ms, assert_reset);
+}
+
+enum ab1815_status_e AB1815::sleep_for(uint32_t duration_ms, uint16_t shutdown_ms, bool assert_reset)
+{
+  AB1815_BUS_GUARD();
+  uint8_t image[AB1815_REG_OSCILLATOR_CONTROL + 1];
+  uint8_t bin[8];
+  if (read(AB1815_REG_TIME_HUNDREDTHS, image, sizeof(image)) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  oscillator_control_t oscillator_control;
+  oscillator_control.value = image[AB1815_REG_OSCILLATOR_CONTROL];
+  ab1815_timer_plan_t plan = plan_periodic_timer(duration_ms, oscillator_control.fields.OSEL);
+  if (duration_ms <= AB1815_COUNTDOWN_MAX_MS && plan.error_us > -1000000L && plan.error_us < 1000000L)
+  {
+    // One shot with a level interrupt, so nIRQ stays asserted to wake up
+    countdown_control_t countdown_control;
+    countdown_control.value = image[AB1815_REG_COUNTDOWN_TIMER_CONTROL];
+    countdown_control.fields.TFS = plan.frequency;
+    countdown_control.fields.TRPT = 0;
+    countdown_control.fields.TM = 0;
+    countdown_control.fields.TE = 1;
+    image[AB1815_REG_COUNTDOWN_TIMER_CONTROL] = countdown_control.value;
+    image[AB1815_REG_COUNTDOWN_TIMER] = plan.initial_value;
+    image[AB1815_REG_COUNTDOWN_TIMER_INITIAL] = plan.initial_value;
+
+    inturrupt_mask_t interrupt_mask;
+    interrupt_mask.value = image[AB1815_REG_INTERRUPT_MASK];
+    interrupt_mask.fields.TIE = 1;
+    image[AB1815_REG_INTERRUPT_MASK] = interrupt_mask.value;
+
+    return enter_sleep(image, AB1815_REG_COUNTDOWN_TIMER_INITIAL, shutdown_ms, assert_reset);
+  }
+
+  ab1815_bcd2bin_block(image, bin, AB1815_TIME_BCD_MASK);
+  return sleep_on_alarm(image, ab1815_block_to_epoch(bin) + (duration_ms + 999) / 1000, shutdown_ms, assert_reset);
+}
+
+enum ab1815_status_e AB1815::get_sleep_status(bool* slept)
+{
+  sleep_control_t sleep_control;
+  if (get_sleep_control(&sleep_control) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  *slept = sleep_control.fields.SLST;
+  return ab1815_status_e_OK;
+}
+
 // 0x1B
 enum ab1815_status_e AB1815::set_watchdog_timer(watchdog_timer_t* watchdog_timer)
 {
@@ -397,6 +1450,82 @@ enum ab1815_status_e AB1815::get_watchdog_timer(watchdog_timer_t* watchdog_timer
   return read(AB1815_REG_WATCHDOG_TIMER, &watchdog_timer->value, 1);
 }
 
+watchdog_timer_t AB1815::plan_watchdog(uint32_t timeout_ms, bool reset)
+{
+  // Watchdog clock ticks per 4 seconds for each WRB setting, fastest first
+  const uint8_t ticks_per_4s[4] = {64, 16, 4, 1};
+  const enum watchdog_timer_frequency_e frequency[4] = {
+    ab1815_watchdog_16HZ, ab1815_watchdog_4HZ, ab1815_watchdog_1HZ, ab1815_watchdog_1_4HZ
+  };
+
+  watchdog_timer_t best;
+  uint32_t best_error = UINT32_MAX;
+  best.value = 0;
+  if (timeout_ms == 0 || timeout_ms > AB1815_WATCHDOG_MAX_MS)
+  {
+    // BMB = 0 marks the plan as invalid, it would disable the watchdog
+    return best;
+  }
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    uint32_t bmb = ((uint64_t)timeout_ms * ticks_per_4s[i] + 2000) / 4000;
+    if (bmb < 1)
+    {
+      bmb = 1;
+    }
+    if (bmb > 31)
+    {
+      bmb = 31;
+    }
+    uint32_t actual_ms = bmb * 4000 / ticks_per_4s[i];
+    uint32_t error = actual_ms > timeout_ms ? actual_ms - timeout_ms : timeout_ms - actual_ms;
+    if (error < best_error)
+    {
+      best_error = error;
+      best.fields.WRB = frequency[i];
+      best.fields.BMB = bmb;
+    }
+  }
+  best.fields.WDS = reset;
+  return best;
+}
+
+enum ab1815_status_e AB1815::watchdog_start(uint32_t timeout_ms, bool reset)
+{
+  watchdog_timer_t watchdog_timer = plan_watchdog(timeout_ms, reset);
+  if (watchdog_timer.fields.BMB == 0)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  return set_watchdog_timer(&watchdog_timer);
+}
+
+enum ab1815_status_e AB1815::watchdog_stop()
+{
+  watchdog_timer_t watchdog_timer;
+  watchdog_timer.value = 0;
+  return set_watchdog_timer(&watchdog_timer);
+}
+
+enum ab1815_status_e AB1815::kick()
+{
+  watchdog_timer_t watchdog_timer;
+  watchdog_timer.value = this->watchdog_value;
+  if (watchdog_timer.fields.BMB == 0)
+  {
+    // Not programmed through this object, for instance after an MCU reset
+    // with the watchdog still running: pick up what the chip has.
+    if (get_watchdog_timer(&watchdog_timer) != ab1815_status_e_OK)
+    {
+      return ab1815_status_e_ERROR;
+    }
+    if (watchdog_timer.fields.BMB == 0)
+    {
+      return ab1815_status_e_ERROR;
+    }
+  }
+  return write(AB1815_REG_WATCHDOG_TIMER, &watchdog_timer.value, 1);
+}
 
 // 0x1C Get the oscillator control register
 enum ab1815_status_e AB1815::get_oscillator_control(struct oscillator_control_t* oscillator_control)
@@ -406,6 +1535,7 @@ enum ab1815_status_e AB1815::get_oscillator_control(struct oscillator_control_t*
 
 enum ab1815_status_e AB1815::set_oscillator_control(struct oscillator_control_t* oscillator_control)
 {
+  AB1815_BUS_GUARD();
   if (set_configuration_key(ab1815_oscillator_control) != ab1815_status_e_OK)
   {
     return ab1815_status_e_ERROR;
@@ -429,6 +1559,23 @@ enum ab1815_status_e AB1815::get_oscillator_status(oscillator_status_t* oscillat
 // 0x1F
 enum ab1815_status_e AB1815::set_configuration_key(enum configuration_key_e configuration_key)
 {
+  if (configuration_key == ab1815_software_reset)
+  {
+    // A software reset puts every register back to its default value but
+    // keeps the RAM, so the fingerprint would no longer describe the chip.
+    // The tracked ARST, watchdog and XADS are stale as well, and the alarm
+    // is gone.
+    invalidate_cache();
+    if (write(AB1815_REG_CONFIGURATION_KEY, (uint8_t*)&configuration_key, 1) != ab1815_status_e_OK)
+    {
+      return ab1815_status_e_ERROR;
+    }
+    this->fields.extension_ram_known = 0;
+    this->fields.arst_known = 0;
+    this->watchdog_value = 0;
+    this->alarm_writes++;
+    return clear_fingerprint();
+  }
   return write(AB1815_REG_CONFIGURATION_KEY, (uint8_t*)&configuration_key, 1);
 };
 
@@ -468,6 +1615,7 @@ enum ab1815_status_e AB1815::get_(afctrl_e* afctrl)
 // 0x27
 enum ab1815_status_e AB1815::set_batmodeio(enum ab1815_batmodeio_e mode)
 {
+  AB1815_BUS_GUARD();
   if (set_configuration_key(ab1815_reg_control) != ab1815_status_e_OK)
   {
     return ab1815_status_e_ERROR;
@@ -485,7 +1633,7 @@ enum ab1815_status_e AB1815::get_batmodeio(enum ab1815_batmodeio_e* mode)
 // 0x28
 enum ab1815_status_e AB1815::get_id(ab1815_id_t* id)
 {
-  size_t length = AB1815_REG_ID6 - AB1815_REG_ID0;
+  size_t length = AB1815_REG_ID6 - AB1815_REG_ID0 + 1;
   uint8_t buffer[length];
   memset(buffer, 0, length);
   enum ab1815_status_e result = ab1815_status_e_ERROR;
@@ -542,8 +1690,22 @@ enum ab1815_status_e AB1815::get_extension_ram(extension_ram_t* extension_ram)
 }
 
 
+#ifdef AB1815_BCD_TABLE
+#define AB1815_BCD_ROW(tens) \
+  tens + 0, tens + 1, tens + 2, tens + 3, tens + 4, tens + 5, tens + 6, tens + 7, \
+  tens + 8, tens + 9, tens + 10, tens + 11, tens + 12, tens + 13, tens + 14, tens + 15
+
+const uint8_t ab1815_bcd2bin_table[256] PROGMEM = {
+  AB1815_BCD_ROW(0), AB1815_BCD_ROW(10), AB1815_BCD_ROW(20), AB1815_BCD_ROW(30),
+  AB1815_BCD_ROW(40), AB1815_BCD_ROW(50), AB1815_BCD_ROW(60), AB1815_BCD_ROW(70),
+  AB1815_BCD_ROW(80), AB1815_BCD_ROW(90), AB1815_BCD_ROW(100), AB1815_BCD_ROW(110),
+  AB1815_BCD_ROW(120), AB1815_BCD_ROW(130), AB1815_BCD_ROW(140), AB1815_BCD_ROW(150)
+};
+#endif
+
 void AB1815::hex_dump(FILE* dump_to)
 {
+  AB1815_BUS_GUARD();
 
   uint8_t buffer[8];
   for (uint8_t pos = 0; pos < 0x7F; pos += 8)
@@ -553,7 +1715,45 @@ void AB1815::hex_dump(FILE* dump_to)
   }
 }
 
+#ifdef AB1815_ENABLE_STATS
+void AB1815::record_transfer(uint16_t* counts, uint8_t offset, uint32_t elapsed_us)
+{
+  counts[offset & 0x7F]++;
+  this->bus_stats.transactions++;
+  uint8_t bucket = 0;
+  elapsed_us >>= 4;
+  while (elapsed_us != 0 && bucket < AB1815_STATS_BUCKETS - 1)
+  {
+    elapsed_us >>= 1;
+    bucket++;
+  }
+  this->bus_stats.latency[bucket]++;
+}
 
+void AB1815::reset_stats()
+{
+  memset(&this->bus_stats, 0, sizeof(this->bus_stats));
+}
 
-
-
+void AB1815::dump_stats(FILE* dump_to)
+{
+  fprintf(dump_to, "# transactions: %lu bytes read: %lu written: %lu cache hits: %lu\r\n",
+          (unsigned long)this->bus_stats.transactions,
+          (unsigned long)this->bus_stats.bytes_read,
+          (unsigned long)this->bus_stats.bytes_written,
+          (unsigned long)this->bus_stats.cache_hits);
+  for (uint8_t reg = 0; reg < 0x80; reg++)
+  {
+    if (this->bus_stats.reads[reg] != 0 || this->bus_stats.writes[reg] != 0)
+    {
+      fprintf(dump_to, "# 0x%02x: reads %u writes %u\r\n", reg, this->bus_stats.reads[reg], this->bus_stats.writes[reg]);
+    }
+  }
+  for (uint8_t bucket = 0; bucket < AB1815_STATS_BUCKETS; bucket++)
+  {
+    fprintf(dump_to, "# %s%lu us: %u\r\n", bucket < AB1815_STATS_BUCKETS - 1 ? "<" : ">=",
+            (unsigned long)16 << (bucket < AB1815_STATS_BUCKETS - 1 ? bucket : bucket - 1),
+            this->bus_stats.latency[bucket]);
+  }
+}
+#endif
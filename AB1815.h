@@ -21,9 +21,9 @@
 #define AB1815_H_
 
 #include "AB1815_registers.h"
+#include "AB1815_transport.h"
 #include "Arduino.h"
 #include "TimeLib.h"
-#include "SPI.h"
 
 struct ab1815_tmElements_t: tmElements_t
 {
@@ -400,6 +400,26 @@ enum ab1815_alarm_repeat_mode {
   ab1815_alarm_repeat_once_per_hundredth = 9 //Invalid without
 };
 
+// 0x18
+enum countdown_timer_frequency_e
+{
+  ab1815_countdown_4096HZ = 0b00, // 128 HZ when running from the RC oscillator
+  ab1815_countdown_64HZ = 0b01,
+  ab1815_countdown_1HZ = 0b10,
+  ab1815_countdown_1_60HZ = 0b11, // 1/60 HZ
+};
+
+// Result of AB1815::plan_periodic_timer
+struct ab1815_timer_plan_t
+{
+  enum countdown_timer_frequency_e frequency;
+  uint8_t initial_value;  // The period is initial_value + 1 ticks
+  int32_t error_us;       // Programmed period minus requested period
+};
+
+// Longest period of the countdown timer, 256 ticks at 1/60 HZ
+#define AB1815_COUNTDOWN_MAX_MS 15360000UL
+
 // 0x1B
 enum watchdog_timer_frequency_e
 {
@@ -430,6 +450,14 @@ enum trickle_charge_resistor_e
   ab1815_trickle_charge_resistor_11k_ohm = 0b11,
 };
 
+// 0x1C - ACAL, trading autocalibration current against RC accuracy
+enum ab1815_rc_policy_e
+{
+  ab1815_rc_policy_lowest_power = 0b00, // No autocalibration
+  ab1815_rc_policy_balanced = 0b10,     // Autocalibrate every 1024 s (~17 min)
+  ab1815_rc_policy_accurate = 0b11,     // Autocalibrate every 512 s (~9 min)
+};
+
 // 0x21
 enum battery_voltage_reference_select_e
 {
@@ -439,33 +467,390 @@ enum battery_voltage_reference_select_e
   ab1815_battery_reference_1v4_1v6 = 0b1111,//Also reset value?
 };
 
+// Pending register writes for AB1815::commit. Registers are collected with
+// add() and emitted in as few SPI bursts as possible: a burst is split only
+// where there is a gap in the pending registers, and every register guarded
+// by the configuration key is written on its own right after the key.
+#define AB1815_BATCH_LENGTH 0x40
+
+struct ab1815_write_batch_t
+{
+  uint8_t values[AB1815_BATCH_LENGTH];
+  uint64_t pending;
+
+  void clear()
+  {
+    pending = 0;
+  }
+
+  void add(uint8_t offset, uint8_t value)
+  {
+    if (offset < AB1815_BATCH_LENGTH)
+    {
+      values[offset] = value;
+      pending |= ((uint64_t)1 << offset);
+    }
+  }
+
+  bool is_pending(uint8_t offset) const
+  {
+    return offset < AB1815_BATCH_LENGTH && (pending & ((uint64_t)1 << offset));
+  }
+};
+
+// Copy of the register space 0x00 - 0x3F, see AB1815::save_image. The
+// status register is left 0 when reading it would clear the flags (ARST).
+struct ab1815_image_t
+{
+  uint8_t registers[AB1815_BATCH_LENGTH];
+};
+
+// restore_image() rewrites unchanged registers of up to this many bytes
+// between two changed ones, which is cheaper than starting another burst.
+#ifndef AB1815_IMAGE_MAX_GAP
+#define AB1815_IMAGE_MAX_GAP 2
+#endif
+
+// Where apply_if_changed() keeps the fingerprint of the applied batch: the
+// last four bytes of RAM bank 0, as a read_ram()/write_ram() address.
+#define AB1815_FINGERPRINT_OFFSET (AB1815_RAM_LENGTH - 4)
+
+// Deferred requests for the *_async methods of AB1815. Requests are queued
+// and run one by one from AB1815::process(), which the application calls
+// from its main loop or from a worker task. The buffers passed in must stay
+// valid until the callback has been invoked.
+#ifndef AB1815_ASYNC_QUEUE_LENGTH
+#define AB1815_ASYNC_QUEUE_LENGTH 4
+#endif
+
+typedef void (*ab1815_callback_t)(enum ab1815_status_e status, void* context);
+
+enum ab1815_async_op_e
+{
+  ab1815_async_read,
+  ab1815_async_write,
+  ab1815_async_get_time,
+  ab1815_async_set_alarm
+};
+
+struct ab1815_async_request_t
+{
+  enum ab1815_async_op_e op;
+  uint8_t offset;
+  uint8_t length;
+  enum ab1815_alarm_repeat_mode alarm_mode;
+  void* data;
+  ab1815_callback_t callback;
+  void* context;
+};
+
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define AB1815_HAS_COROUTINES 1
+#include <coroutine>
+#endif
+#if __has_include(<chrono>)
+#define AB1815_HAS_CHRONO 1
+#include <chrono>
+#endif
+#endif
+
+struct ab1815_awaitable;
+
+// Protects the request queue indices. Requests are submitted from tasks and
+// from ISRs while process() may run in a worker task, so this is needed with
+// or without the bus lock. The previous interrupt state is restored on exit
+// instead of enabling interrupts, which keeps submit_from_isr() from
+// enabling them inside the ISR.
+#if defined(ESP32)
+extern portMUX_TYPE ab1815_queue_mux;
+#define AB1815_QUEUE_ENTER() portENTER_CRITICAL_SAFE(&ab1815_queue_mux)
+#define AB1815_QUEUE_EXIT() portEXIT_CRITICAL_SAFE(&ab1815_queue_mux)
+#elif defined(__AVR__)
+#define AB1815_QUEUE_ENTER() uint8_t ab1815_sreg = SREG; cli()
+#define AB1815_QUEUE_EXIT() SREG = ab1815_sreg
+#elif defined(__ARM_ARCH_PROFILE) && __ARM_ARCH_PROFILE == 'M'
+#define AB1815_QUEUE_ENTER() uint32_t ab1815_primask; \
+  __asm__ volatile ("mrs %0, primask\n\tcpsid i" : "=r" (ab1815_primask) : : "memory")
+#define AB1815_QUEUE_EXIT() __asm__ volatile ("msr primask, %0" : : "r" (ab1815_primask) : "memory")
+#elif defined(ESP8266)
+#define AB1815_QUEUE_ENTER() uint32_t ab1815_ps = xt_rsil(15)
+#define AB1815_QUEUE_EXIT() xt_wsr_ps(ab1815_ps)
+#else
+#if !defined(ARDUINO) && defined(__has_include)
+#if __has_include(<mutex>)
+#define AB1815_QUEUE_MUTEX 1
+#endif
+#endif
+#ifdef AB1815_QUEUE_MUTEX
+// Host builds, where process() may run in another thread
+#include <mutex>
+extern std::mutex ab1815_queue_mutex;
+#define AB1815_QUEUE_ENTER() ab1815_queue_mutex.lock()
+#define AB1815_QUEUE_EXIT() ab1815_queue_mutex.unlock()
+#else
+// Cores without a known way to save the interrupt state, submit_from_isr()
+// leaves interrupts enabled on these.
+#define AB1815_QUEUE_ENTER() noInterrupts()
+#define AB1815_QUEUE_EXIT() interrupts()
+#endif
+#endif
+
+// Optional bus arbitration, see AB1815_lock.h
+#ifdef AB1815_ENABLE_BUS_LOCK
+#include "AB1815_lock.h"
+#define AB1815_BUS_GUARD() ab1815_bus_guard bus_guard(&this->bus_lock)
+#else
+#define AB1815_BUS_GUARD()
+#endif
+
+// Statistics of the extrapolated clock, see AB1815::set_time_cache
+struct ab1815_time_cache_stats_t
+{
+  uint32_t hits;            // get() calls served without bus traffic
+  uint32_t resyncs;         // get() calls which read the time registers
+  uint32_t drift_exceeded;  // resyncs where drift was over the tolerance
+  int32_t last_drift_ms;    // RTC minus extrapolated time at the last resync
+  int32_t max_drift_ms;     // Largest absolute drift seen
+};
+
+// micros() wraps after about 71 minutes, the resync interval stays below that
+#define AB1815_TIME_CACHE_MAX_INTERVAL_MS 1800000UL
+#define AB1815_MICROS_WRAP_MS 4294967UL
+
+// Longest timeout of AB1815::plan_watchdog, BMB = 31 at 1/4 Hz
+#define AB1815_WATCHDOG_MAX_MS 124000UL
+
+// Longest shutdown_ms of AB1815::sleep_until/sleep_for, SLTO = 7
+#define AB1815_SLEEP_MAX_SHUTDOWN_MS 54
+
+// Time, alarm and status from one burst of 0x00 - 0x0F, see AB1815::get_snapshot
+struct ab1815_snapshot_t
+{
+  ab1815_tmElements_t time;
+  ab1815_tmElements_t alarm;  // Year is not part of the alarm, the repeat mode lives in 0x18
+  status_t status;
+  time_t epoch;
+};
+
+// Direct conversions between the decoded time block (register n in byte n,
+// see ab1815_bcd2bin_block) and seconds since 1970, without going through
+// tmElements_t. They use the constant time days-from-civil arithmetic
+// instead of the per year/month loops of makeTime() and breakTime().
+int32_t ab1815_days_from_civil(int16_t year, uint8_t month, uint8_t day);
+void ab1815_civil_from_days(int32_t days, int16_t* year, uint8_t* month, uint8_t* day);
+time_t ab1815_block_to_epoch(const uint8_t* bin);
+void ab1815_epoch_to_block(time_t epoch, uint8_t* bin);
+
+// Bus instrumentation, compiled in with AB1815_ENABLE_STATS. Transfers are
+// counted by the register they start at, latency is a histogram of
+// micros() per transfer: bucket 0 is below 16 us, each next one doubles the
+// bound and the last one takes everything longer.
+#ifdef AB1815_ENABLE_STATS
+#define AB1815_STATS_BUCKETS 8
+
+struct ab1815_bus_stats_t
+{
+  uint16_t reads[0x80];
+  uint16_t writes[0x80];
+  uint32_t transactions;    // Bus transfers of any kind
+  uint32_t bytes_read;
+  uint32_t bytes_written;
+  uint32_t cache_hits;
+  uint16_t latency[AB1815_STATS_BUCKETS];
+};
+#endif
+
+// Shadow cache of the configuration registers, see AB1815::set_cache_enabled
+#define AB1815_CACHE_FIRST  AB1815_REG_CONTROL1
+#define AB1815_CACHE_LAST   AB1815_REG_OUTPUT_CONTROL
+#define AB1815_CACHE_LENGTH (AB1815_CACHE_LAST - AB1815_CACHE_FIRST + 1)
+
 class AB1815
 {
   private:
 
     uint64_t error_code;
 
-    uint16_t cs_pin;
+    bool cache_enabled;
+    uint8_t cache[AB1815_CACHE_LENGTH];
+    uint8_t cache_valid[(AB1815_CACHE_LENGTH + 7) / 8];
+
+    ab1815_transport_t transport;
     struct {
       uint8_t _12_24: 2;
       uint8_t clk_source: 2;
+      uint8_t arst: 1;
+      uint8_t arst_known: 1;
+      uint8_t extension_ram_known: 1;
     } fields;
 
+    // Last value of 0x3F seen on the bus, valid with extension_ram_known.
+    // It is read once before the first paged RAM access.
+    uint8_t extension_ram;
+
+    uint32_t time_cache_interval_ms;
+    uint32_t time_cache_tolerance_ms;
+    uint32_t time_cache_effective_ms;
+    bool time_anchor_valid;
+    time_t time_anchor;
+    uint32_t time_anchor_us;
+    uint32_t time_anchor_ms;
+    ab1815_time_cache_stats_t time_cache_stats;
+
+    uint8_t watchdog_value;
+    uint8_t alarm_writes;
+
+#ifdef AB1815_ENABLE_STATS
+    ab1815_bus_stats_t bus_stats;
+    void record_transfer(uint16_t* counts, uint8_t offset, uint32_t elapsed_us);
+#endif
+
+    time_t resync_time();
+    enum ab1815_status_e read_epoch(time_t* epoch, uint8_t* hundredths);
+    enum ab1815_status_e sleep_on_alarm(uint8_t* image, time_t wake_at, uint16_t shutdown_ms, bool assert_reset);
+    enum ab1815_status_e enter_sleep(uint8_t* image, uint8_t last, uint16_t shutdown_ms, bool assert_reset);
+
+    ab1815_async_request_t async_queue[AB1815_ASYNC_QUEUE_LENGTH];
+    uint8_t async_head;
+    uint8_t async_count;
+
+#ifdef AB1815_ENABLE_BUS_LOCK
+    ab1815_bus_lock bus_lock;
+#ifdef AB1815_LOCK_FREERTOS
+    TaskHandle_t worker;
+    static void worker_task(void* clock);
+#endif
+#endif
+
     enum ab1815_status_e init();
-    enum ab1815_status_e read(uint8_t offset, uint8_t* buf, uint8_t length);
-    enum ab1815_status_e write(uint8_t offset, uint8_t* buf, uint8_t length);
-    void spi_select_slave(bool select);
+    bool enqueue(ab1815_async_request_t* request);
 
-    SPISettings spiSettings = SPISettings((uint32_t)1000000, MSBFIRST, SPI_MODE0);
+    static uint8_t configuration_key_for(uint8_t offset);
+    static bool is_cacheable(uint8_t offset);
+    static bool is_restorable(uint8_t offset);
+    bool cache_hit(uint8_t offset, uint8_t length);
+    void cache_store(uint8_t offset, uint8_t* buf, uint8_t length);
+    void track_registers(uint8_t offset, uint8_t* buf, uint8_t length);
+    enum ab1815_status_e select_ram_bank(uint8_t bank);
+    enum ab1815_status_e ram_transfer(uint8_t address, uint8_t* buf, uint16_t length, bool write_ram);
 
   public:
     ab1815_id_t id;
 
+    // cs_pin is the chip select pin for the SPI transport, the bus address
+    // for the I2C transport and unused by the mock transport.
     AB1815(uint16_t cs_pin);
 
+    ab1815_transport_t* get_transport()
+    {
+      return &transport;
+    }
+
+    // Keep a RAM copy of the configuration registers (0x10 - 0x30) so that
+    // reads of them are served without SPI traffic. Registers that the chip
+    // changes on its own (time, status, countdown timer and its control,
+    // sleep control, oscillator status, analog status) are never cached, nor
+    // are the key protected ones. Writes always go to the chip and update
+    // the copy.
+    void set_cache_enabled(bool enabled);
+    void invalidate_cache();
+
+    // Write every pending register of the batch, using the configuration
+    // key where the chip requires it.
+    enum ab1815_status_e commit(ab1815_write_batch_t* batch);
+
+    // Read the whole register space in one burst (two with ARST set, which
+    // skip the status register).
+    enum ab1815_status_e save_image(ab1815_image_t* image);
+
+    // Write back the configuration of a saved image. The chip is read first
+    // and only registers that differ are written, through commit(). The
+    // time, status, countdown value, oscillator status, key, ID, analog
+    // status and reserved registers are not restored, and SLP is never set.
+    enum ab1815_status_e restore_image(const ab1815_image_t* image);
+
+    // FNV-1a hash of the pending registers and values of a batch
+    static uint32_t fingerprint(const ab1815_write_batch_t* batch);
+
+    // Warm boot fast path. Compares the fingerprint of the batch with the one
+    // stored in RTC RAM (a single 4 byte read) and commits the batch only
+    // when they differ, storing the new fingerprint afterwards. applied, if
+    // not NULL, tells whether anything was written. The batch is cleared
+    // either way.
+    enum ab1815_status_e apply_if_changed(ab1815_write_batch_t* batch, bool* applied);
+
+    // Forget the stored fingerprint so the next apply_if_changed() writes
+    enum ab1815_status_e clear_fingerprint();
+
+    // The 256 bytes of user RAM, address 0 - 255 across the four XADS banks.
+    // The bank is paged into 0x40 - 0x7F with XADS for the transfer and bank
+    // 0 is selected again afterwards. The first access after construction or
+    // a software reset reads 0x3F, since XADS may have been left non-zero.
+    enum ab1815_status_e read_ram(uint8_t address, uint8_t* buf, uint16_t length);
+    enum ab1815_status_e write_ram(uint8_t address, uint8_t* buf, uint16_t length);
+
+    // Raw register access, length bytes starting at offset in one burst.
+    enum ab1815_status_e read(uint8_t offset, uint8_t* buf, uint8_t length);
+    enum ab1815_status_e write(uint8_t offset, uint8_t* buf, uint8_t length);
+
+    // Non-blocking variants. They return ab1815_status_e_ERROR straight away
+    // if the queue is full, otherwise the result is passed to callback once
+    // the request has been run by process().
+    enum ab1815_status_e read_async(uint8_t offset, uint8_t* buf, uint8_t length, ab1815_callback_t callback, void* context);
+    enum ab1815_status_e write_async(uint8_t offset, uint8_t* buf, uint8_t length, ab1815_callback_t callback, void* context);
+    enum ab1815_status_e get_time_async(ab1815_tmElements_t* time, ab1815_callback_t callback, void* context);
+    enum ab1815_status_e set_alarm_async(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode alarm_mode, ab1815_callback_t callback, void* context);
+    enum ab1815_status_e submit(ab1815_async_request_t* request);
+
+    // Run the oldest queued request. Returns false if the queue was empty.
+    bool process();
+    uint8_t pending_async();
+
+#ifdef AB1815_ENABLE_BUS_LOCK
+    // Queue a request from an interrupt handler. The bus is never touched
+    // from the ISR, the request runs later from process() or the worker.
+    enum ab1815_status_e submit_from_isr(ab1815_async_request_t* request);
+
+    ab1815_bus_lock* get_bus_lock()
+    {
+      return &bus_lock;
+    }
+
+#ifdef AB1815_LOCK_FREERTOS
+    // Start a task which runs queued requests as soon as they are submitted
+    enum ab1815_status_e start_worker(UBaseType_t priority, uint32_t stack_size);
+#endif
+#endif
+
+#ifdef AB1815_HAS_COROUTINES
+    // co_await clock->read_await(...) suspends the coroutine until process()
+    // has run the request and yields its status.
+    ab1815_awaitable read_await(uint8_t offset, uint8_t* buf, uint8_t length);
+    ab1815_awaitable write_await(uint8_t offset, uint8_t* buf, uint8_t length);
+    ab1815_awaitable get_time_await(ab1815_tmElements_t* time);
+    ab1815_awaitable set_alarm_await(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode alarm_mode);
+#endif
+
+    // Serve get() from micros() extrapolated from the last RTC read, going
+    // back to the bus once resync_interval_ms has passed. When a resync finds
+    // the drift above drift_tolerance_ms the interval is halved, and it grows
+    // back towards resync_interval_ms while the drift stays in tolerance.
+    // An interval of 0 disables the cache.
+    //
+    // millis() and micros() stop while the MCU sleeps in power down, so
+    // call invalidate_time_cache() after any MCU sleep the driver did not
+    // start; sleep_until() and sleep_for() do it themselves.
+    void set_time_cache(uint32_t resync_interval_ms, uint32_t drift_tolerance_ms);
+    void invalidate_time_cache();
+    ab1815_time_cache_stats_t* get_time_cache_stats();
+
     // 0x00
     time_t get();
     void set(time_t time);
+
+    // Milliseconds since 1970 with the hundredths register, one burst read
+    uint64_t get_ms();
     enum ab1815_status_e get_time(ab1815_tmElements_t* time);
     enum ab1815_status_e set_time(ab1815_tmElements_t* time);
     enum ab1815_status_e hundrdeds();
@@ -475,12 +860,26 @@ class AB1815
     enum ab1815_status_e get_alarm(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode* alarm_mode);
     enum ab1815_status_e set_alarm(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode alarm_mode);
 
+    // Counts the writes to the alarm registers (0x08 - 0x0E) and to the
+    // alarm repeat in 0x18, wrapping at 256. Lets AB1815_alarm_queue notice
+    // that set_alarm(), sleep_until() and the like replaced its alarm.
+    uint8_t get_alarm_writes();
+
     // 0x0F - See also: ARST in Control1.
     //	If ARST is a 1, a read of the Status register will produce the current state of all
     //	the interrupt flags and then clear them
     enum ab1815_status_e set_status(status_t* status);
     enum ab1815_status_e get_status(status_t* status);
 
+    // Whether ARST in control1 is set, i.e. reading the status register also
+    // clears it. Only goes to the bus if control1 has not been seen yet.
+    enum ab1815_status_e get_status_auto_clear(bool* arst);
+
+    // 0x00 - 0x0F in a single transfer, so the flags belong to exactly the
+    // time that was read. With ARST set this consumes the status flags like
+    // get_status() does.
+    enum ab1815_status_e get_snapshot(ab1815_snapshot_t* snapshot);
+
     // 0x10
     enum ab1815_status_e set_control1(control1_t* control1);
     enum ab1815_status_e get_control1(control1_t* control1);
@@ -509,6 +908,20 @@ class AB1815
     enum ab1815_status_e set_cal_rc_low(cal_rc_low_t* cal_rc_low);
     enum ab1815_status_e get_cal_rc_low(cal_rc_low_t* cal_rc_low);
 
+    // RC oscillator error in ppm from an interval timed on both the RTC and
+    // a reference, positive when the RTC runs fast.
+    static int32_t rc_error_ppm(uint32_t rtc_elapsed_ms, uint32_t reference_elapsed_ms);
+
+    // Compute CMDR/OFFSETR correcting error_ppm. The correction is counted in
+    // steps of 2^-20 (0.954 ppm); CMDR scales each OFFSETR count by 2^CMDR
+    // and the smallest scale that fits the 14 bit signed OFFSETR is used.
+    // Returns ab1815_status_e_ERROR when the error is out of range.
+    static enum ab1815_status_e plan_rc_calibration(int32_t error_ppm, cal_rc_hi_t* cal_rc_hi, cal_rc_low_t* cal_rc_low);
+
+    // Write 0x15 - 0x16 in one burst
+    enum ab1815_status_e calibrate_rc(int32_t error_ppm);
+    enum ab1815_status_e set_rc_policy(enum ab1815_rc_policy_e policy);
+
     // 0x17 sleep_control_t
     enum ab1815_status_e set_sleep_control(sleep_control_t* sleep_control);
     enum ab1815_status_e get_sleep_control(sleep_control_t* sleep_control);
@@ -525,10 +938,59 @@ class AB1815
     enum ab1815_status_e set_countdown_timer_initial_value(uint8_t timer_value);
     enum ab1815_status_e get_countdown_timer_initial_value(uint8_t* timer_value);
 
+    // Pick the countdown frequency and initial value closest to period_ms.
+    // On equal error the slower, lower power, frequency wins.
+    static ab1815_timer_plan_t plan_periodic_timer(uint32_t period_ms, bool rc_oscillator);
+
+    // Start the countdown timer with the best plan for period_ms and write
+    // 0x18 - 0x1A in one burst. With repeat the timer reloads after every
+    // expiry, pulse selects a pulsed rather than level nTIRQ. TIE in the
+    // interrupt mask is left to the application. plan may be NULL. A period
+    // of 0 or above AB1815_COUNTDOWN_MAX_MS returns ab1815_status_e_ERROR
+    // without touching the timer.
+    enum ab1815_status_e set_periodic_timer(uint32_t period_ms, bool repeat, bool pulse, ab1815_timer_plan_t* plan);
+    enum ab1815_status_e stop_periodic_timer();
+
+    // Put the chip to sleep (and with PWR2/OUT2S set up for the power switch,
+    // the MCU with it) until wake_at or for duration_ms. sleep_for uses the
+    // countdown timer when it can hit the duration within a second, otherwise
+    // the alarm, which sleep_until always uses. SLTO is chosen so the sleep
+    // starts no earlier than shutdown_ms after the call (at most
+    // AB1815_SLEEP_MAX_SHUTDOWN_MS, seven 7.8 ms SLTO periods; a longer
+    // shutdown_ms is an error, and 0 still waits one period), and assert_reset
+    // holds nRST low while asleep (SLRES). All interrupt flags are cleared,
+    // since a pending one would make the chip reject the sleep.
+    //
+    // The whole sequence is one burst read of 0x00 - 0x1C, one burst write
+    // of the alarm/status/control block, the SLP write, and a read back of
+    // the sleep control register. ab1815_status_e_ERROR is returned if the
+    // chip rejected the sleep or shutdown_ms is out of range.
+    enum ab1815_status_e sleep_until(time_t wake_at, uint16_t shutdown_ms, bool assert_reset);
+    enum ab1815_status_e sleep_for(uint32_t duration_ms, uint16_t shutdown_ms, bool assert_reset);
+
+    // SLST, set if the chip went to sleep since sleep control was last written
+    enum ab1815_status_e get_sleep_status(bool* slept);
+
     // 0x1B
     enum ab1815_status_e set_watchdog_timer(watchdog_timer_t* watchdog_timer);
     enum ab1815_status_e get_watchdog_timer(watchdog_timer_t* watchdog_timer);
 
+    // The WRB clock and BMB count closest to timeout_ms. A timeout of 0 or
+    // above AB1815_WATCHDOG_MAX_MS gives a plan with BMB = 0, which
+    // watchdog_start() rejects. reset selects nRST (WDS = 1) over the WIRQ
+    // interrupt.
+    static watchdog_timer_t plan_watchdog(uint32_t timeout_ms, bool reset);
+
+    // kick() restarts the watchdog with a single one byte write of the last
+    // value that went through 0x1B (watchdog_start(), set_watchdog_timer(),
+    // restore_image(), ...), nothing is read back. When none is known, as
+    // after an MCU reset, 0x1B is read once; kick() returns
+    // ab1815_status_e_ERROR when no watchdog is programmed. watchdog_start()
+    // returns ab1815_status_e_ERROR when timeout_ms is out of range.
+    enum ab1815_status_e watchdog_start(uint32_t timeout_ms, bool reset);
+    enum ab1815_status_e watchdog_stop();
+    enum ab1815_status_e kick();
+
 
     // 0x1C Get the oscillator control register
     enum ab1815_status_e get_oscillator_control(oscillator_control_t* oscillator_control);
@@ -576,8 +1038,117 @@ class AB1815
 
     void hex_dump(FILE* dump_to);
 
+#ifdef AB1815_ENABLE_STATS
+    ab1815_bus_stats_t* get_stats()
+    {
+      return &bus_stats;
+    }
+    void reset_stats();
+    void dump_stats(FILE* dump_to);
+#endif
+
+};
+
+#ifdef AB1815_HAS_CHRONO
+// std::chrono clock backed by the RTC, for code written against the Clock
+// concept. bind() selects the AB1815 that now() reads.
+struct ab1815_clock
+{
+  typedef std::chrono::milliseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<ab1815_clock> time_point;
+  static const bool is_steady = false;
+
+  static AB1815* source;
+
+  static void bind(AB1815* clock)
+  {
+    source = clock;
+  }
+
+  static time_point now()
+  {
+    return time_point(duration((rep)source->get_ms()));
+  }
+
+  static time_t to_time_t(const time_point& time)
+  {
+    return (time_t)std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+  }
+
+  static time_point from_time_t(time_t time)
+  {
+    return time_point(std::chrono::duration_cast<duration>(std::chrono::seconds(time)));
+  }
+};
+#endif
+
+#ifdef AB1815_HAS_COROUTINES
+struct ab1815_awaitable
+{
+  AB1815* clock;
+  ab1815_async_request_t request;
+  enum ab1815_status_e status;
+  std::coroutine_handle<> handle;
+
+  bool await_ready()
+  {
+    return false;
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle)
+  {
+    this->handle = handle;
+    request.callback = &ab1815_awaitable::resume;
+    request.context = this;
+    // Once queued, a worker task may complete the request and resume, or
+    // even destroy, the coroutine before submit() returns, so this must not
+    // be touched after a successful submit.
+    enum ab1815_status_e submitted = clock->submit(&request);
+    if (submitted == ab1815_status_e_OK)
+    {
+      return true;
+    }
+    // Carry on without suspending if the request could not be queued
+    status = submitted;
+    return false;
+  }
+
+  enum ab1815_status_e await_resume()
+  {
+    return status;
+  }
+
+  static void resume(enum ab1815_status_e status, void* context)
+  {
+    ab1815_awaitable* self = (ab1815_awaitable*)context;
+    self->status = status;
+    self->handle.resume();
+  }
 };
 
+inline ab1815_awaitable AB1815::read_await(uint8_t offset, uint8_t* buf, uint8_t length)
+{
+  return ab1815_awaitable{this, {ab1815_async_read, offset, length, ab1815_alarm_repeat_alarm_disabled, buf, nullptr, nullptr}, ab1815_status_e_OK, {}};
+}
+
+inline ab1815_awaitable AB1815::write_await(uint8_t offset, uint8_t* buf, uint8_t length)
+{
+  return ab1815_awaitable{this, {ab1815_async_write, offset, length, ab1815_alarm_repeat_alarm_disabled, buf, nullptr, nullptr}, ab1815_status_e_OK, {}};
+}
+
+inline ab1815_awaitable AB1815::get_time_await(ab1815_tmElements_t* time)
+{
+  return ab1815_awaitable{this, {ab1815_async_get_time, 0, 0, ab1815_alarm_repeat_alarm_disabled, time, nullptr, nullptr}, ab1815_status_e_OK, {}};
+}
+
+inline ab1815_awaitable AB1815::set_alarm_await(ab1815_tmElements_t* time, enum ab1815_alarm_repeat_mode alarm_mode)
+{
+  return ab1815_awaitable{this, {ab1815_async_set_alarm, 0, 0, alarm_mode, time, nullptr, nullptr}, ab1815_status_e_OK, {}};
+}
+#endif
+
 inline uint8_t bcd2bin(uint8_t value)
 {
   return (value & 0x0F) + ((value >> 4) * 10);
@@ -588,6 +1159,88 @@ inline uint8_t bin2bcd(uint8_t value)
   return ((value / 10) << 4) + value % 10;
 }
 
+// Valid BCD bits of the time (0x00 - 0x07) and alarm (0x08 - 0x0E) blocks,
+// register n in byte n of a little endian word.
+#define AB1815_TIME_BCD_MASK  0x07FF1F3F3F7F7FFFULL
+#define AB1815_ALARM_BCD_MASK 0x00071F3F3F7F7FFFULL
+
+// Whole block BCD conversion of up to 8 registers. AVR uses a lookup table
+// since 64 bit arithmetic is slow there. Every other target, 32 bit ARM and
+// ESP32 included, treats the block as one 64 bit word and converts all
+// fields at once (SWAR), which 32 bit cores do in pairs of registers.
+// examples/BCDBench compares both against bcd2bin()/bin2bcd().
+#if defined(__AVR__)
+#define AB1815_BCD_TABLE 1
+extern const uint8_t ab1815_bcd2bin_table[256] PROGMEM;
+#endif
+
+inline void ab1815_bcd2bin_block(const uint8_t* bcd, uint8_t* bin, uint64_t mask)
+{
+#ifdef AB1815_BCD_TABLE
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    bin[i] = pgm_read_byte(&ab1815_bcd2bin_table[bcd[i] & (uint8_t)(mask >> (8 * i))]);
+  }
+#else
+  uint64_t word = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(&word, bcd, 8);
+#else
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    word |= (uint64_t)bcd[i] << (8 * i);
+  }
+#endif
+  word &= mask;
+  // 16 * tens + units - 6 * tens = 10 * tens + units, in every byte
+  word -= 6 * ((word >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(bin, &word, 8);
+#else
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    bin[i] = word >> (8 * i);
+  }
+#endif
+#endif
+}
+
+// Values must be below 100
+inline void ab1815_bin2bcd_block(const uint8_t* bin, uint8_t* bcd)
+{
+#ifdef AB1815_BCD_TABLE
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    bcd[i] = bin2bcd(bin[i]);
+  }
+#else
+  uint64_t word = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(&word, bin, 8);
+#else
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    word |= (uint64_t)bin[i] << (8 * i);
+  }
+#endif
+  // Even and odd bytes are spread over 16 bit lanes, so that value * 103
+  // fits its lane. (value * 103) >> 10 == value / 10 for value < 100.
+  uint64_t even = word & 0x00FF00FF00FF00FFULL;
+  uint64_t odd = (word >> 8) & 0x00FF00FF00FF00FFULL;
+  even += 6 * (((even * 103) >> 10) & 0x000F000F000F000FULL);
+  odd += 6 * (((odd * 103) >> 10) & 0x000F000F000F000FULL);
+  word = even | (odd << 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(bcd, &word, 8);
+#else
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    bcd[i] = word >> (8 * i);
+  }
+#endif
+#endif
+}
+
 #endif /* AB1815_H_ */
 
 
@@ -0,0 +1,206 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#include "AB1815_alarm_queue.h"
+
+AB1815_alarm_queue::AB1815_alarm_queue(AB1815* clock)
+{
+  this->clock = clock;
+  this->programmed_valid = false;
+  this->armed = false;
+  this->armed_deadline = 0;
+  this->alarm_writes = clock->get_alarm_writes();
+  for (uint8_t i = 0; i < AB1815_ALARM_QUEUE_LENGTH; i++)
+  {
+    this->entries[i].active = false;
+  }
+}
+
+int8_t AB1815_alarm_queue::head()
+{
+  int8_t nearest = -1;
+  for (uint8_t i = 0; i < AB1815_ALARM_QUEUE_LENGTH; i++)
+  {
+    if (this->entries[i].active && (nearest < 0 || this->entries[i].deadline < this->entries[nearest].deadline))
+    {
+      nearest = i;
+    }
+  }
+  return nearest;
+}
+
+enum ab1815_status_e AB1815_alarm_queue::set_repeat(enum ab1815_alarm_repeat_mode mode)
+{
+  countdown_control_t countdown_control;
+  if (clock->get_countdown_control(&countdown_control) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  if (countdown_control.fields.RPT == mode)
+  {
+    return ab1815_status_e_OK;
+  }
+  countdown_control.fields.RPT = mode;
+  return clock->set_countdown_control(&countdown_control);
+}
+
+void AB1815_alarm_queue::dispatch_due(time_t now)
+{
+  for (uint8_t i = 0; i < AB1815_ALARM_QUEUE_LENGTH; i++)
+  {
+    if (this->entries[i].active && this->entries[i].deadline <= now)
+    {
+      // Free the slot first so that the handler can schedule again
+      this->entries[i].active = false;
+      if (this->entries[i].handler != NULL)
+      {
+        this->entries[i].handler(i, this->entries[i].context);
+      }
+    }
+  }
+}
+
+void AB1815_alarm_queue::invalidate()
+{
+  this->programmed_valid = false;
+  this->armed = false;
+}
+
+enum ab1815_status_e AB1815_alarm_queue::arm()
+{
+  for (;;)
+  {
+    if (this->alarm_writes != clock->get_alarm_writes())
+    {
+      invalidate();
+    }
+
+    // A deadline that has already gone by would only match again next year,
+    // so those run now instead of being programmed.
+    time_t now = clock->get();
+    dispatch_due(now);
+
+    int8_t nearest = head();
+    if (nearest < 0)
+    {
+      if (!this->armed)
+      {
+        return ab1815_status_e_OK;
+      }
+      this->armed = false;
+      enum ab1815_status_e status = set_repeat(ab1815_alarm_repeat_alarm_disabled);
+      this->alarm_writes = clock->get_alarm_writes();
+      return status;
+    }
+
+    time_t deadline = this->entries[nearest].deadline;
+    if (this->armed && deadline == this->armed_deadline)
+    {
+      return ab1815_status_e_OK;
+    }
+
+    // Hundredths up to month, the weekday is not compared once per year
+    uint8_t bin[8];
+    uint8_t bcd[8];
+    ab1815_epoch_to_block(deadline, bin);
+    ab1815_bin2bcd_block(bin, bcd);
+
+    uint8_t first = 0;
+    uint8_t last = sizeof(this->programmed);
+    if (this->programmed_valid)
+    {
+      while (first < last && bcd[first] == this->programmed[first])
+      {
+        first++;
+      }
+      while (last > first && bcd[last - 1] == this->programmed[last - 1])
+      {
+        last--;
+      }
+    }
+    if (first < last)
+    {
+      if (clock->write(AB1815_REG_ALARM_HUNDREDTHS + first, &bcd[first], last - first) != ab1815_status_e_OK)
+      {
+        this->programmed_valid = false;
+        return ab1815_status_e_ERROR;
+      }
+      memcpy(&this->programmed[first], &bcd[first], last - first);
+      this->programmed_valid = true;
+    }
+
+    if (!this->armed && set_repeat(ab1815_alarm_repeat_once_per_year) != ab1815_status_e_OK)
+    {
+      return ab1815_status_e_ERROR;
+    }
+    this->armed = true;
+    this->armed_deadline = deadline;
+    this->alarm_writes = clock->get_alarm_writes();
+
+    // The deadline may have been reached while the registers were written,
+    // in which case the match could already be missed.
+    if (deadline > now + 1 || deadline > clock->get())
+    {
+      return ab1815_status_e_OK;
+    }
+  }
+}
+
+int8_t AB1815_alarm_queue::add(time_t deadline, ab1815_alarm_handler_t handler, void* context)
+{
+  for (uint8_t i = 0; i < AB1815_ALARM_QUEUE_LENGTH; i++)
+  {
+    if (!this->entries[i].active)
+    {
+      this->entries[i].deadline = deadline;
+      this->entries[i].handler = handler;
+      this->entries[i].context = context;
+      this->entries[i].active = true;
+      if (arm() != ab1815_status_e_OK)
+      {
+        this->entries[i].active = false;
+        return -1;
+      }
+      return i;
+    }
+  }
+  return -1;
+}
+
+enum ab1815_status_e AB1815_alarm_queue::cancel(uint8_t id)
+{
+  if (id >= AB1815_ALARM_QUEUE_LENGTH || !this->entries[id].active)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  this->entries[id].active = false;
+  return arm();
+}
+
+enum ab1815_status_e AB1815_alarm_queue::service()
+{
+  return arm();
+}
+
+void AB1815_alarm_queue::on_alarm(enum ab1815_event_e event, void* queue)
+{
+  (void)event;
+  ((AB1815_alarm_queue*)queue)->service();
+}
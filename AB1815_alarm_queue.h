@@ -0,0 +1,92 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#ifndef AB1815_ALARM_QUEUE_H_
+#define AB1815_ALARM_QUEUE_H_
+
+#include "AB1815.h"
+#include "AB1815_events.h"
+
+#ifndef AB1815_ALARM_QUEUE_LENGTH
+#define AB1815_ALARM_QUEUE_LENGTH 8
+#endif
+
+typedef void (*ab1815_alarm_handler_t)(uint8_t id, void* context);
+
+struct ab1815_alarm_entry_t
+{
+  time_t deadline;
+  ab1815_alarm_handler_t handler;
+  void* context;
+  bool active;
+};
+
+// Any number of software alarms multiplexed on the single hardware alarm.
+//
+// The nearest deadline is always the one programmed into the alarm
+// registers (0x08 - 0x0D), matching once per year so that the full date is
+// compared. Only the registers that differ from what is already programmed
+// are written, and nothing is written when the head of the queue is
+// unchanged. Writes to the alarm made around the queue, by set_alarm() or
+// sleep_until() for instance, are noticed through
+// AB1815::get_alarm_writes() and the next service() programs the whole
+// block again. service() must run when the ALM interrupt fires, either
+// directly or by registering on_alarm with AB1815_events. AIE has to be
+// enabled in the interrupt mask by the application.
+class AB1815_alarm_queue
+{
+  private:
+    AB1815* clock;
+    ab1815_alarm_entry_t entries[AB1815_ALARM_QUEUE_LENGTH];
+
+    // What the alarm registers currently hold
+    uint8_t programmed[6];
+    bool programmed_valid;
+    bool armed;
+    time_t armed_deadline;
+    uint8_t alarm_writes;   // AB1815::get_alarm_writes() after our last write
+
+    int8_t head();
+    void dispatch_due(time_t now);
+    enum ab1815_status_e arm();
+    enum ab1815_status_e set_repeat(enum ab1815_alarm_repeat_mode mode);
+
+  public:
+    AB1815_alarm_queue(AB1815* clock);
+
+    // Returns the id of the alarm, or -1 if the queue is full. Handlers of
+    // deadlines that have already passed, this one included, run before
+    // add() returns, so the id may already be free again, or taken by an
+    // alarm one of those handlers added.
+    int8_t add(time_t deadline, ab1815_alarm_handler_t handler, void* context);
+    enum ab1815_status_e cancel(uint8_t id);
+
+    // Run the handlers of every alarm that is due and arm the next one
+    enum ab1815_status_e service();
+
+    // Forget what the alarm registers hold, so that the next service()
+    // writes the whole block. Only needed when the alarm is changed without
+    // going through this AB1815 object.
+    void invalidate();
+
+    static void on_alarm(enum ab1815_event_e event, void* queue);
+};
+
+#endif /* AB1815_ALARM_QUEUE_H_ */
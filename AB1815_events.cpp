@@ -0,0 +1,104 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#include "AB1815_events.h"
+
+AB1815_events* AB1815_events::instance = NULL;
+
+AB1815_events::AB1815_events(AB1815* clock)
+{
+  this->clock = clock;
+  this->irq_pending = false;
+  for (uint8_t i = 0; i < ab1815_event_count; i++)
+  {
+    this->handlers[i] = NULL;
+    this->contexts[i] = NULL;
+  }
+}
+
+void AB1815_events::on(enum ab1815_event_e event, ab1815_event_handler_t handler, void* context)
+{
+  if (event < ab1815_event_count)
+  {
+    this->handlers[event] = handler;
+    this->contexts[event] = context;
+  }
+}
+
+void AB1815_events::nirq_isr()
+{
+  if (instance != NULL)
+  {
+    instance->irq_pending = true;
+  }
+}
+
+void AB1815_events::attach(uint8_t nirq_pin)
+{
+  instance = this;
+  pinMode(nirq_pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(nirq_pin), &AB1815_events::nirq_isr, FALLING);
+}
+
+enum ab1815_status_e AB1815_events::service()
+{
+  if (!this->irq_pending)
+  {
+    return ab1815_status_e_OK;
+  }
+  this->irq_pending = false;
+  return dispatch();
+}
+
+enum ab1815_status_e AB1815_events::dispatch()
+{
+  bool arst;
+  status_t status;
+
+  if (clock->get_status_auto_clear(&arst) != ab1815_status_e_OK ||
+      clock->get_status(&status) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  // Without ARST the flags stay set until written back as 0. Only the flags
+  // that were read are written as 0; the others are written as 1, which
+  // leaves them alone, so a flag raised since the read is not lost. CB is
+  // the century bit, not an interrupt flag, and is written back unchanged.
+  uint8_t flags = status.value & ((1 << ab1815_event_count) - 1);
+  if (!arst && flags != 0)
+  {
+    status_t cleared;
+    cleared.value = (~flags & ((1 << ab1815_event_count) - 1)) | (status.value & ~((1 << ab1815_event_count) - 1));
+    if (clock->set_status(&cleared) != ab1815_status_e_OK)
+    {
+      return ab1815_status_e_ERROR;
+    }
+  }
+
+  for (uint8_t event = 0; event < ab1815_event_count; event++)
+  {
+    if ((flags & (1 << event)) && this->handlers[event] != NULL)
+    {
+      this->handlers[event]((enum ab1815_event_e)event, this->contexts[event]);
+    }
+  }
+  return ab1815_status_e_OK;
+}
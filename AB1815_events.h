@@ -0,0 +1,74 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+#ifndef AB1815_EVENTS_H_
+#define AB1815_EVENTS_H_
+
+#include "AB1815.h"
+
+// Interrupt sources of the status register (0x0F), numbered by their bit
+enum ab1815_event_e
+{
+  ab1815_event_ex1 = 0,
+  ab1815_event_ex2 = 1,
+  ab1815_event_alarm = 2,
+  ab1815_event_timer = 3,
+  ab1815_event_battery_low = 4,
+  ab1815_event_watchdog = 5,
+  ab1815_event_battery = 6,
+  ab1815_event_count = 7
+};
+
+typedef void (*ab1815_event_handler_t)(enum ab1815_event_e event, void* context);
+
+// Dispatches the interrupt flags of the AB1815 to registered handlers.
+//
+// attach() hooks the nIRQ pin so the ISR only records that an interrupt is
+// pending, service() then does the bus work from the main loop. Each
+// dispatch costs a single status read when ARST is set in control1 (the
+// read clears the flags), otherwise a second write clears the flags that
+// were handled.
+class AB1815_events
+{
+  private:
+    AB1815* clock;
+    ab1815_event_handler_t handlers[ab1815_event_count];
+    void* contexts[ab1815_event_count];
+    volatile bool irq_pending;
+
+    static AB1815_events* instance;
+    static void nirq_isr();
+
+  public:
+    AB1815_events(AB1815* clock);
+
+    void on(enum ab1815_event_e event, ab1815_event_handler_t handler, void* context);
+
+    // nIRQ is active low, so the pin is configured as an input with pull-up
+    // and interrupts on the falling edge.
+    void attach(uint8_t nirq_pin);
+
+    // Dispatch if the ISR flagged an interrupt since the last call
+    enum ab1815_status_e service();
+
+    // Read the status register once and call the handler of every set flag
+    enum ab1815_status_e dispatch();
+};
+
+#endif /* AB1815_EVENTS_H_ */
@@ -0,0 +1,183 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#include "AB1815_kv.h"
+
+AB1815_kv::AB1815_kv(AB1815* clock, uint8_t first, uint16_t length)
+{
+  this->clock = clock;
+  this->first = first;
+  this->length = length;
+}
+
+// CRC-8, polynomial 0x07
+uint8_t AB1815_kv::crc8(const uint8_t* data, uint16_t length)
+{
+  uint8_t crc = 0;
+  while (length-- > 0)
+  {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+uint16_t AB1815_kv::find(uint8_t* image, uint8_t key, uint16_t* end)
+{
+  uint16_t found = this->length;
+  uint16_t offset = 2;
+  while (offset + 3 <= this->length && image[offset] != AB1815_KV_END)
+  {
+    uint16_t next = offset + 3 + image[offset + 1];
+    if (next > this->length)
+    {
+      // A length running past the region, treat it as the end
+      break;
+    }
+    if (image[offset] == key && found == this->length)
+    {
+      found = offset;
+    }
+    offset = next;
+  }
+  *end = offset;
+  return found;
+}
+
+enum ab1815_status_e AB1815_kv::begin()
+{
+  uint8_t magic[2];
+  if (this->length < 3 || this->clock->read_ram(this->first, magic, 2) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  if (magic[0] != AB1815_KV_MAGIC0 || magic[1] != AB1815_KV_MAGIC1)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  return ab1815_status_e_OK;
+}
+
+enum ab1815_status_e AB1815_kv::format()
+{
+  uint8_t header[3] = {AB1815_KV_MAGIC0, AB1815_KV_MAGIC1, AB1815_KV_END};
+  if (this->length < 3)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  return this->clock->write_ram(this->first, header, 3);
+}
+
+enum ab1815_status_e AB1815_kv::get(uint8_t key, uint8_t* value, uint8_t max_length, uint8_t* value_length)
+{
+  uint8_t image[this->length];
+  uint16_t end;
+  if (key == AB1815_KV_END || this->clock->read_ram(this->first, image, this->length) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  uint16_t offset = find(image, key, &end);
+  if (offset == this->length)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  uint8_t record_length = image[offset + 1];
+  if (record_length > max_length || crc8(&image[offset], record_length + 2) != image[offset + 2 + record_length])
+  {
+    return ab1815_status_e_ERROR;
+  }
+  memcpy(value, &image[offset + 2], record_length);
+  *value_length = record_length;
+  return ab1815_status_e_OK;
+}
+
+enum ab1815_status_e AB1815_kv::put(uint8_t key, const uint8_t* value, uint8_t value_length)
+{
+  uint8_t image[this->length];
+  uint16_t end;
+  if (key == AB1815_KV_END || this->clock->read_ram(this->first, image, this->length) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  uint16_t offset = find(image, key, &end);
+
+  if (offset != this->length && image[offset + 1] == value_length)
+  {
+    // Same size, the record is updated in place
+    uint8_t* data = &image[offset + 2];
+    if (memcmp(data, value, value_length) == 0 && crc8(&image[offset], value_length + 2) == data[value_length])
+    {
+      return ab1815_status_e_OK;
+    }
+    memcpy(data, value, value_length);
+    data[value_length] = crc8(&image[offset], value_length + 2);
+    return this->clock->write_ram(this->first + offset + 2, data, value_length + 1);
+  }
+
+  uint16_t changed = end;
+  if (offset != this->length)
+  {
+    // Close the gap of the old record, everything behind it moves
+    uint16_t size = 3 + image[offset + 1];
+    memmove(&image[offset], &image[offset + size], end - offset - size);
+    end -= size;
+    changed = offset;
+  }
+  if (end + 3 + value_length > this->length)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  image[end] = key;
+  image[end + 1] = value_length;
+  memcpy(&image[end + 2], value, value_length);
+  image[end + 2 + value_length] = crc8(&image[end], value_length + 2);
+  end += 3 + value_length;
+  if (end < this->length)
+  {
+    image[end++] = AB1815_KV_END;
+  }
+  return this->clock->write_ram(this->first + changed, &image[changed], end - changed);
+}
+
+enum ab1815_status_e AB1815_kv::remove(uint8_t key)
+{
+  uint8_t image[this->length];
+  uint16_t end;
+  if (key == AB1815_KV_END || this->clock->read_ram(this->first, image, this->length) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  uint16_t offset = find(image, key, &end);
+  if (offset == this->length)
+  {
+    return ab1815_status_e_OK;
+  }
+
+  uint16_t size = 3 + image[offset + 1];
+  memmove(&image[offset], &image[offset + size], end - offset - size);
+  end -= size;
+  image[end++] = AB1815_KV_END;
+  return this->clock->write_ram(this->first + offset, &image[offset], end - offset);
+}
@@ -0,0 +1,74 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#ifndef AB1815_KV_H_
+#define AB1815_KV_H_
+
+#include "AB1815.h"
+
+#define AB1815_KV_MAGIC0 0xAB
+#define AB1815_KV_MAGIC1 0x4B
+#define AB1815_KV_END    0xFF
+
+// A small key-value store in the battery backed user RAM of the clock, for
+// state that has to survive PSW power down (sequence counters, last uplink
+// time) without wearing the flash.
+//
+// The store owns length bytes of RAM starting at address first (0 - 255,
+// see AB1815::read_ram). The region starts with two magic bytes followed by
+// packed records:
+//
+//   key (0 - 0xFE), data length, data, CRC-8 of key, length and data
+//
+// ended by a key of 0xFF or the end of the region. Every operation reads
+// the region in one burst per RAM bank and writes back only the bytes it
+// changed. Keep the region clear of the configuration fingerprint in the
+// last four bytes of bank 0 when apply_if_changed() is used.
+class AB1815_kv
+{
+  private:
+    AB1815* clock;
+    uint8_t first;
+    uint16_t length;
+
+    // Offset of the record with the key, or of the end of the records
+    uint16_t find(uint8_t* image, uint8_t key, uint16_t* end);
+
+  public:
+    AB1815_kv(AB1815* clock, uint8_t first, uint16_t length);
+
+    static uint8_t crc8(const uint8_t* data, uint16_t length);
+
+    // ERROR if the region does not hold a store, format() it then
+    enum ab1815_status_e begin();
+
+    // Erase every record
+    enum ab1815_status_e format();
+
+    // ERROR if the key is missing, the record is corrupt or longer than max_length
+    enum ab1815_status_e get(uint8_t key, uint8_t* value, uint8_t max_length, uint8_t* value_length);
+
+    // ERROR if the record does not fit in the region
+    enum ab1815_status_e put(uint8_t key, const uint8_t* value, uint8_t value_length);
+
+    enum ab1815_status_e remove(uint8_t key);
+};
+
+#endif /* AB1815_KV_H_ */
@@ -0,0 +1,169 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+#ifndef AB1815_LOCK_H_
+#define AB1815_LOCK_H_
+
+// Bus arbitration for AB1815_ENABLE_BUS_LOCK builds. Every public AB1815
+// operation holds the lock for its whole duration, so multi transaction
+// sequences such as set_alarm() cannot interleave with other users of the
+// bus. The lock is recursive: operations built from other operations take
+// it again without blocking themselves.
+//
+// On FreeRTOS (ESP32, or any core that has included FreeRTOS.h) a recursive
+// mutex is used, and set_mutex() lets the radio and flash drivers share the
+// same one. Host builds use std::recursive_mutex. Cores with neither, such
+// as bare AVR, get a lock that does nothing, which is enough there since
+// only interrupts can preempt the caller and they go through submit_from_isr.
+
+#include "Arduino.h"
+
+#if defined(ESP32)
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#define AB1815_LOCK_FREERTOS 1
+#elif defined(INC_FREERTOS_H)
+#include "semphr.h"
+#include "task.h"
+#define AB1815_LOCK_FREERTOS 1
+#elif defined(__has_include)
+#if __has_include(<mutex>)
+#include <mutex>
+#define AB1815_LOCK_STD 1
+#endif
+#endif
+
+struct ab1815_lock_stats_t
+{
+  uint32_t acquisitions;
+  uint32_t contended;      // Acquisitions which had to wait for another task
+  uint32_t wait_us_total;
+  uint32_t wait_us_max;
+};
+
+class ab1815_bus_lock
+{
+  private:
+#if defined(AB1815_LOCK_FREERTOS)
+    SemaphoreHandle_t mutex;
+#elif defined(AB1815_LOCK_STD)
+    std::recursive_mutex mutex;
+#endif
+
+#if defined(AB1815_LOCK_FREERTOS)
+    bool try_take()
+    {
+      return xSemaphoreTakeRecursive(mutex, 0) == pdTRUE;
+    }
+
+    void take()
+    {
+      xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    }
+#elif defined(AB1815_LOCK_STD)
+    bool try_take()
+    {
+      return mutex.try_lock();
+    }
+
+    void take()
+    {
+      mutex.lock();
+    }
+#endif
+
+  public:
+    ab1815_lock_stats_t stats;
+
+    ab1815_bus_lock()
+    {
+#ifdef AB1815_LOCK_FREERTOS
+      mutex = xSemaphoreCreateRecursiveMutex();
+#endif
+      reset_stats();
+    }
+
+#ifdef AB1815_LOCK_FREERTOS
+    // Share the mutex of the other drivers on the bus. It must have been
+    // created with xSemaphoreCreateRecursiveMutex().
+    void set_mutex(SemaphoreHandle_t shared)
+    {
+      mutex = shared;
+    }
+#endif
+
+    void reset_stats()
+    {
+      memset(&stats, 0, sizeof(stats));
+    }
+
+    void lock()
+    {
+#if defined(AB1815_LOCK_FREERTOS) || defined(AB1815_LOCK_STD)
+      // The statistics are only updated while the lock is held
+      if (try_take())
+      {
+        stats.acquisitions++;
+        return;
+      }
+      uint32_t start = micros();
+      take();
+      uint32_t waited = micros() - start;
+      stats.acquisitions++;
+      stats.contended++;
+      stats.wait_us_total += waited;
+      if (waited > stats.wait_us_max)
+      {
+        stats.wait_us_max = waited;
+      }
+#else
+      stats.acquisitions++;
+#endif
+    }
+
+    void unlock()
+    {
+#if defined(AB1815_LOCK_FREERTOS)
+      xSemaphoreGiveRecursive(mutex);
+#elif defined(AB1815_LOCK_STD)
+      mutex.unlock();
+#endif
+    }
+};
+
+class ab1815_bus_guard
+{
+  private:
+    ab1815_bus_lock* bus_lock;
+
+  public:
+    ab1815_bus_guard(ab1815_bus_lock* bus_lock)
+    {
+      this->bus_lock = bus_lock;
+      bus_lock->lock();
+    }
+
+    ~ab1815_bus_guard()
+    {
+      bus_lock->unlock();
+    }
+};
+
+#endif /* AB1815_LOCK_H_ */
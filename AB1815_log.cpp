@@ -0,0 +1,181 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#include "AB1815_log.h"
+
+AB1815_log::AB1815_log(AB1815* clock, uint8_t first, uint16_t length)
+{
+  this->clock = clock;
+  this->first = first;
+  uint16_t entries = length < AB1815_LOG_HEADER_SIZE ? 0 : (length - AB1815_LOG_HEADER_SIZE) / AB1815_LOG_ENTRY_SIZE;
+  this->capacity = entries > 32 ? 32 : entries;
+  this->head = 0;
+  this->next_sequence = 1;
+  this->count = 0;
+}
+
+uint8_t AB1815_log::sequence_after(uint8_t sequence)
+{
+  return sequence == 0xFF ? 1 : sequence + 1;
+}
+
+enum ab1815_status_e AB1815_log::begin()
+{
+  if (this->capacity == 0)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  uint8_t region[AB1815_LOG_HEADER_SIZE + this->capacity * AB1815_LOG_ENTRY_SIZE];
+  if (this->clock->read_ram(this->first, region, sizeof(region)) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  if (region[0] != AB1815_LOG_MAGIC0 || region[1] != AB1815_LOG_MAGIC1 ||
+      region[2] != AB1815_LOG_VERSION || region[3] != this->capacity)
+  {
+    return clear();
+  }
+
+  uint8_t* image = &region[AB1815_LOG_HEADER_SIZE];
+  this->head = 0;
+  this->next_sequence = 1;
+  this->count = 0;
+  for (uint8_t slot = 0; slot < this->capacity; slot++)
+  {
+    uint8_t sequence = image[slot * AB1815_LOG_ENTRY_SIZE];
+    uint8_t following = image[((slot + 1) % this->capacity) * AB1815_LOG_ENTRY_SIZE];
+    if (sequence != 0 && following != sequence_after(sequence))
+    {
+      // The newest entry, the slot behind it is the oldest or still empty
+      this->head = (slot + 1) % this->capacity;
+      this->next_sequence = sequence_after(sequence);
+      this->count = following == 0 ? slot + 1 : this->capacity;
+      break;
+    }
+  }
+  return ab1815_status_e_OK;
+}
+
+enum ab1815_status_e AB1815_log::clear()
+{
+  if (this->capacity == 0)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  uint8_t region[AB1815_LOG_HEADER_SIZE + this->capacity * AB1815_LOG_ENTRY_SIZE];
+  memset(region, 0, sizeof(region));
+  region[0] = AB1815_LOG_MAGIC0;
+  region[1] = AB1815_LOG_MAGIC1;
+  region[2] = AB1815_LOG_VERSION;
+  region[3] = this->capacity;
+  this->head = 0;
+  this->next_sequence = 1;
+  this->count = 0;
+  return this->clock->write_ram(this->first, region, sizeof(region));
+}
+
+enum ab1815_status_e AB1815_log::append(ab1815_log_entry_t* entries, uint8_t entry_count)
+{
+  if (this->capacity == 0 || entry_count == 0 || entry_count > this->capacity)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  uint32_t now = 0;
+  for (uint8_t i = 0; i < entry_count; i++)
+  {
+    if (entries[i].time == 0 && now == 0)
+    {
+      now = this->clock->get() - AB1815_LOG_EPOCH;
+    }
+  }
+
+  uint8_t buffer[entry_count * AB1815_LOG_ENTRY_SIZE];
+  for (uint8_t i = 0; i < entry_count; i++)
+  {
+    uint8_t* entry = &buffer[i * AB1815_LOG_ENTRY_SIZE];
+    uint32_t time = entries[i].time == 0 ? now : entries[i].time;
+    entry[0] = this->next_sequence;
+    entry[1] = entries[i].type;
+    entry[2] = entries[i].data;
+    entry[3] = entries[i].data >> 8;
+    entry[4] = time;
+    entry[5] = time >> 8;
+    entry[6] = time >> 16;
+    entry[7] = time >> 24;
+    this->next_sequence = sequence_after(this->next_sequence);
+  }
+
+  // Up to the end of the ring, then the rest from the start
+  uint8_t run = this->capacity - this->head;
+  if (run > entry_count)
+  {
+    run = entry_count;
+  }
+  if (run > 0 && this->clock->write_ram(this->first + AB1815_LOG_HEADER_SIZE + this->head * AB1815_LOG_ENTRY_SIZE, buffer,
+                                        run * AB1815_LOG_ENTRY_SIZE) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+  if (run < entry_count && this->clock->write_ram(this->first + AB1815_LOG_HEADER_SIZE, &buffer[run * AB1815_LOG_ENTRY_SIZE],
+                                                  (entry_count - run) * AB1815_LOG_ENTRY_SIZE) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  this->head = (this->head + entry_count) % this->capacity;
+  this->count = this->count + entry_count > this->capacity ? this->capacity : this->count + entry_count;
+  return ab1815_status_e_OK;
+}
+
+enum ab1815_status_e AB1815_log::append(uint8_t type, uint16_t data)
+{
+  ab1815_log_entry_t entry;
+  entry.type = type;
+  entry.data = data;
+  entry.time = 0;
+  return append(&entry, 1);
+}
+
+enum ab1815_status_e AB1815_log::read(ab1815_log_entry_t* entries, uint8_t max_entries, uint8_t* entry_count)
+{
+  *entry_count = 0;
+  if (this->count == 0)
+  {
+    return ab1815_status_e_OK;
+  }
+  uint8_t image[this->capacity * AB1815_LOG_ENTRY_SIZE];
+  if (this->clock->read_ram(this->first + AB1815_LOG_HEADER_SIZE, image, sizeof(image)) != ab1815_status_e_OK)
+  {
+    return ab1815_status_e_ERROR;
+  }
+
+  uint8_t oldest = (this->head + this->capacity - this->count) % this->capacity;
+  uint8_t copied = this->count < max_entries ? this->count : max_entries;
+  for (uint8_t i = 0; i < copied; i++)
+  {
+    uint8_t* entry = &image[((oldest + i) % this->capacity) * AB1815_LOG_ENTRY_SIZE];
+    entries[i].type = entry[1];
+    entries[i].data = entry[2] | (uint16_t)entry[3] << 8;
+    entries[i].time = entry[4] | (uint32_t)entry[5] << 8 | (uint32_t)entry[6] << 16 | (uint32_t)entry[7] << 24;
+  }
+  *entry_count = copied;
+  return ab1815_status_e_OK;
+}
@@ -0,0 +1,94 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#ifndef AB1815_LOG_H_
+#define AB1815_LOG_H_
+
+#include "AB1815.h"
+
+#define AB1815_LOG_ENTRY_SIZE 8
+
+// Region header: magic, format version and the capacity it was formatted for
+#define AB1815_LOG_HEADER_SIZE 4
+#define AB1815_LOG_MAGIC0      0xAB
+#define AB1815_LOG_MAGIC1      0x4C
+#define AB1815_LOG_VERSION     1
+
+// Seconds between 1970-01-01 and 2000-01-01, log times count from 2000
+#define AB1815_LOG_EPOCH 946684800UL
+
+struct ab1815_log_entry_t
+{
+  uint8_t type;     // Application defined, e.g. an ab1815_event_e
+  uint16_t data;
+  uint32_t time;    // Seconds since 2000, 0 stamps the entry when appended
+};
+
+// Append-only event log in a ring buffer of the user RAM, which outlives
+// PSW power down of the MCU.
+//
+// The region starts with a 4 byte header (magic, version, capacity) that
+// tells a log apart from other data or power on garbage in the RAM. Every
+// entry after it is 8 bytes: a sequence number, type, data and a 32 bit
+// time. The sequence number runs 1 - 255 and 0 marks an empty slot, so
+// begin() finds the head by reading the region once and looking for the
+// place where the sequence breaks; no head pointer has to be stored. The
+// region holds (length - 4) / 8 entries, at most 32, and needs room for one.
+// With apply_if_changed() in use the region must not reach into the last
+// four bytes of bank 0, where the configuration fingerprint is kept.
+class AB1815_log
+{
+  private:
+    AB1815* clock;
+    uint8_t first;
+    uint8_t capacity;
+    uint8_t head;           // Slot the next entry goes to
+    uint8_t next_sequence;
+    uint8_t count;
+
+    static uint8_t sequence_after(uint8_t sequence);
+
+  public:
+    AB1815_log(AB1815* clock, uint8_t first, uint16_t length);
+
+    // Find the head in the RAM, must be called before anything else. A
+    // region without a matching header is formatted as an empty log. ERROR
+    // if the region cannot hold a single entry.
+    enum ab1815_status_e begin();
+
+    // Drop every entry and write the header
+    enum ab1815_status_e clear();
+
+    // Append entries in one burst (two when the ring wraps). Entries with a
+    // time of 0 are stamped with the current time, read once per call.
+    // ERROR for an entry_count of 0 or above the capacity.
+    enum ab1815_status_e append(ab1815_log_entry_t* entries, uint8_t entry_count);
+    enum ab1815_status_e append(uint8_t type, uint16_t data);
+
+    // Copy up to max_entries of the log out, oldest first, with one read
+    enum ab1815_status_e read(ab1815_log_entry_t* entries, uint8_t max_entries, uint8_t* entry_count);
+
+    uint8_t size()
+    {
+      return count;
+    }
+};
+
+#endif /* AB1815_LOG_H_ */
@@ -0,0 +1,253 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#ifndef AB1815_PROFILE_H_
+#define AB1815_PROFILE_H_
+
+#include "AB1815.h"
+
+// Power on values of the registers a profile covers
+#define AB1815_CONTROL1_DEFAULT           0x13
+#define AB1815_CONTROL2_DEFAULT           0x3C
+#define AB1815_INTERRUPT_MASK_DEFAULT     0xE0
+#define AB1815_OSCILLATOR_CONTROL_DEFAULT 0x00
+
+// A declarative configuration of control1, control2, the interrupt mask and
+// the oscillator control register, built at compile time:
+//
+//   AB1815_DECLARE_PROFILE(psw_profile, ab1815_profile()
+//       .hour_24()
+//       .psw_sleep()
+//       .rc_oscillator()
+//       .alarm_interrupt(ab1815_interrupt_im_level));
+//
+// Every setter returns a new profile, so the whole chain is a constant
+// expression (C++11 constexpr allows nothing else). Bits a profile does not
+// mention keep their power on value, which makes the result a complete
+// image of the four registers. AB1815_DECLARE_PROFILE rejects invalid
+// combinations with static_assert. apply() writes the image through
+// AB1815::commit, apply_if_changed() skips it on warm boots.
+class ab1815_profile
+{
+  private:
+    uint8_t control1, control1_set;
+    uint8_t control2, control2_set;
+    uint8_t interrupt_mask, interrupt_mask_set;
+    uint8_t oscillator_control, oscillator_control_set;
+    bool conflict;
+
+    constexpr ab1815_profile(uint8_t control1, uint8_t control1_set, uint8_t control2, uint8_t control2_set,
+                             uint8_t interrupt_mask, uint8_t interrupt_mask_set,
+                             uint8_t oscillator_control, uint8_t oscillator_control_set, bool conflict)
+      : control1(control1), control1_set(control1_set), control2(control2), control2_set(control2_set),
+        interrupt_mask(interrupt_mask), interrupt_mask_set(interrupt_mask_set),
+        oscillator_control(oscillator_control), oscillator_control_set(oscillator_control_set), conflict(conflict)
+    {
+    }
+
+    static constexpr uint8_t merge(uint8_t current, uint8_t mask, uint8_t value)
+    {
+      return (uint8_t)((current & ~mask) | (value & mask));
+    }
+
+    // A bit given twice with different values
+    static constexpr bool clashes(uint8_t current, uint8_t set, uint8_t mask, uint8_t value)
+    {
+      return ((current ^ value) & set & mask) != 0;
+    }
+
+    constexpr ab1815_profile with(uint8_t offset, uint8_t mask, uint8_t value) const
+    {
+      return ab1815_profile(
+          offset == AB1815_REG_CONTROL1 ? merge(control1, mask, value) : control1,
+          offset == AB1815_REG_CONTROL1 ? (uint8_t)(control1_set | mask) : control1_set,
+          offset == AB1815_REG_CONTROL2 ? merge(control2, mask, value) : control2,
+          offset == AB1815_REG_CONTROL2 ? (uint8_t)(control2_set | mask) : control2_set,
+          offset == AB1815_REG_INTERRUPT_MASK ? merge(interrupt_mask, mask, value) : interrupt_mask,
+          offset == AB1815_REG_INTERRUPT_MASK ? (uint8_t)(interrupt_mask_set | mask) : interrupt_mask_set,
+          offset == AB1815_REG_OSCILLATOR_CONTROL ? merge(oscillator_control, mask, value) : oscillator_control,
+          offset == AB1815_REG_OSCILLATOR_CONTROL ? (uint8_t)(oscillator_control_set | mask) : oscillator_control_set,
+          conflict ||
+          (offset == AB1815_REG_CONTROL1 && clashes(control1, control1_set, mask, value)) ||
+          (offset == AB1815_REG_CONTROL2 && clashes(control2, control2_set, mask, value)) ||
+          (offset == AB1815_REG_INTERRUPT_MASK && clashes(interrupt_mask, interrupt_mask_set, mask, value)) ||
+          (offset == AB1815_REG_OSCILLATOR_CONTROL && clashes(oscillator_control, oscillator_control_set, mask, value)));
+    }
+
+    constexpr uint8_t out2s() const
+    {
+      return (control2 >> 2) & 0x07;
+    }
+
+    constexpr uint8_t out1s() const
+    {
+      return control2 & 0x03;
+    }
+
+  public:
+    constexpr ab1815_profile()
+      : control1(0), control1_set(0), control2(0), control2_set(0),
+        interrupt_mask(0), interrupt_mask_set(0),
+        oscillator_control(0), oscillator_control_set(0), conflict(false)
+    {
+    }
+
+    // 0x10
+    constexpr ab1815_profile hour_24() const
+    {
+      return with(AB1815_REG_CONTROL1, 0x40, 0x00);
+    }
+
+    constexpr ab1815_profile hour_12() const
+    {
+      return with(AB1815_REG_CONTROL1, 0x40, 0x40);
+    }
+
+    // ARST, reading the status register clears it
+    constexpr ab1815_profile auto_clear_status(bool enabled) const
+    {
+      return with(AB1815_REG_CONTROL1, 0x04, enabled ? 0x04 : 0x00);
+    }
+
+    // PWR2, nIRQ2 is the power switch instead of a plain output
+    constexpr ab1815_profile power_switch(bool enabled) const
+    {
+      return with(AB1815_REG_CONTROL1, 0x02, enabled ? 0x02 : 0x00);
+    }
+
+    // 0x11
+    constexpr ab1815_profile nirq_function(enum ab1815_fout_nirq_pin_control_e function) const
+    {
+      return with(AB1815_REG_CONTROL2, 0x03, function);
+    }
+
+    constexpr ab1815_profile nirq2_function(enum ab1815_psw_nirq2_pin_control_e function) const
+    {
+      return with(AB1815_REG_CONTROL2, 0x1C, function << 2);
+    }
+
+    // The power switch on nIRQ2 opens when the clock goes to sleep
+    constexpr ab1815_profile psw_sleep() const
+    {
+      return nirq2_function(ab1815_psw_SLEEP).power_switch(true);
+    }
+
+    // 0x12
+    constexpr ab1815_profile alarm_interrupt(enum ab1815_interrupt_im_e mode) const
+    {
+      return with(AB1815_REG_INTERRUPT_MASK, 0x64, 0x04 | (mode << 5));
+    }
+
+    constexpr ab1815_profile timer_interrupt(bool enabled) const
+    {
+      return with(AB1815_REG_INTERRUPT_MASK, 0x08, enabled ? 0x08 : 0x00);
+    }
+
+    // 0x1C
+    constexpr ab1815_profile rc_oscillator() const
+    {
+      return with(AB1815_REG_OSCILLATOR_CONTROL, 0x80, 0x80);
+    }
+
+    constexpr ab1815_profile crystal_oscillator() const
+    {
+      return with(AB1815_REG_OSCILLATOR_CONTROL, 0x80, 0x00);
+    }
+
+    // PWGT, the serial interface is disabled while the clock sleeps
+    constexpr ab1815_profile power_gate_interface(bool enabled) const
+    {
+      return with(AB1815_REG_OSCILLATOR_CONTROL, 0x04, enabled ? 0x04 : 0x00);
+    }
+
+    // The register image, unset bits at their power on value
+    constexpr uint8_t image(uint8_t offset) const
+    {
+      return offset == AB1815_REG_CONTROL1 ? merge(AB1815_CONTROL1_DEFAULT, control1_set, control1) :
+             offset == AB1815_REG_CONTROL2 ? merge(AB1815_CONTROL2_DEFAULT, control2_set, control2) :
+             offset == AB1815_REG_INTERRUPT_MASK ? merge(AB1815_INTERRUPT_MASK_DEFAULT, interrupt_mask_set, interrupt_mask) :
+             merge(AB1815_OSCILLATOR_CONTROL_DEFAULT, oscillator_control_set, oscillator_control);
+    }
+
+    // Checks for AB1815_DECLARE_PROFILE
+    constexpr bool consistent() const
+    {
+      return !conflict;
+    }
+
+    constexpr bool psw_valid() const
+    {
+      return !(control2_set & 0x1C) || out2s() != ab1815_psw_SLEEP || ((control1_set & 0x02) && (control1 & 0x02));
+    }
+
+    constexpr bool outputs_valid() const
+    {
+      return nirq2_valid() && nirq_valid();
+    }
+
+    constexpr bool nirq2_valid() const
+    {
+      return !(control2_set & 0x1C) ||
+             (out2s() != ab1815_psw_RESERVED &&
+              (out2s() != ab1815_psw_nAIRQ_or_OUTB || (image(AB1815_REG_INTERRUPT_MASK) & 0x04)) &&
+              ((out2s() != ab1815_psw_TIRQ_or_OUTB && out2s() != ab1815_psw_nTIRQ_or_OUTB) ||
+               (image(AB1815_REG_INTERRUPT_MASK) & 0x08)));
+    }
+
+    constexpr bool nirq_valid() const
+    {
+      return !(control2_set & 0x03) || out1s() != ab1815_fout_nAIRQ_or_OUT || (image(AB1815_REG_INTERRUPT_MASK) & 0x04);
+    }
+
+    void add_to(ab1815_write_batch_t* batch) const
+    {
+      batch->add(AB1815_REG_CONTROL1, image(AB1815_REG_CONTROL1));
+      batch->add(AB1815_REG_CONTROL2, image(AB1815_REG_CONTROL2));
+      batch->add(AB1815_REG_INTERRUPT_MASK, image(AB1815_REG_INTERRUPT_MASK));
+      batch->add(AB1815_REG_OSCILLATOR_CONTROL, image(AB1815_REG_OSCILLATOR_CONTROL));
+    }
+
+    // One burst for 0x10 - 0x12, the key and 0x1C
+    enum ab1815_status_e apply(AB1815* clock) const
+    {
+      ab1815_write_batch_t batch;
+      batch.clear();
+      add_to(&batch);
+      return clock->commit(&batch);
+    }
+
+    // As apply(), but nothing is written when the fingerprint in RTC RAM
+    // shows this profile was the last one applied
+    enum ab1815_status_e apply_if_changed(AB1815* clock, bool* applied) const
+    {
+      ab1815_write_batch_t batch;
+      batch.clear();
+      add_to(&batch);
+      return clock->apply_if_changed(&batch, applied);
+    }
+};
+
+#define AB1815_DECLARE_PROFILE(name, profile) \
+  constexpr ab1815_profile name = profile; \
+  static_assert(name.consistent(), #name ": a setting is given twice with different values"); \
+  static_assert(name.psw_valid(), #name ": nIRQ2 set to SLEEP needs PWR2, use psw_sleep()"); \
+  static_assert(name.outputs_valid(), #name ": the nIRQ/nIRQ2 function needs its interrupt enabled")
+
+#endif /* AB1815_PROFILE_H_ */
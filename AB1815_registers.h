@@ -59,6 +59,10 @@
 
 #define AB1815_EXTENTION_RAM 0x3F
 
+// 64 bytes of the user RAM, the bank is selected with XADS in 0x3F
+#define AB1815_RAM 0x40
+#define AB1815_RAM_LENGTH 0x40
+
 
 
 #endif /* AB1815_REGISTERS_H_ */
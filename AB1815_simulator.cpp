@@ -0,0 +1,455 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#include "AB1815_simulator.h"
+
+#ifdef AB1815_TRANSPORT_SIMULATOR
+ab1815_simulator ab1815_simulator::shared;
+#endif
+
+#define SIM_STATUS_ALM  0x04
+#define SIM_STATUS_TIM  0x08
+#define SIM_STATUS_WDT  0x20
+#define SIM_STATUS_CB   0x80
+#define SIM_STATUS_FLAGS 0x7F
+
+#define SIM_CONTROL1_WRTC 0x01
+#define SIM_CONTROL1_ARST 0x04
+#define SIM_CONTROL1_STOP 0x80
+
+#define SIM_SLEEP_SLST 0x08
+#define SIM_SLEEP_SLP  0x80
+
+#define SIM_COUNTDOWN_TRPT 0x20
+#define SIM_COUNTDOWN_TE   0x80
+
+#define SIM_OSCILLATOR_OSEL 0x80
+#define SIM_INTERRUPT_CEB   0x80
+
+static uint8_t sim_bcd2bin(uint8_t value)
+{
+  return (value & 0x0F) + ((value >> 4) * 10);
+}
+
+static uint8_t sim_bin2bcd(uint8_t value)
+{
+  return ((value / 10) << 4) + value % 10;
+}
+
+ab1815_simulator::ab1815_simulator()
+{
+  memset(this->ram, 0, sizeof(this->ram));
+  reset();
+}
+
+void ab1815_simulator::reset()
+{
+  memset(this->registers, 0, sizeof(this->registers));
+  this->registers[AB1815_REG_CONTROL1] = 0x13;
+  this->registers[AB1815_REG_CONTROL2] = 0x3C;
+  this->registers[AB1815_REG_INTERRUPT_MASK] = 0xE0;
+  this->registers[AB1815_REG_SQW] = 0x26;
+  this->registers[AB1815_REG_COUNTDOWN_TIMER_CONTROL] = 0x23;
+  this->registers[AB1815_REG_BREF_CONTROL] = 0xF0;
+  this->registers[AB1815_REG_BATMODE_IO] = 0x80;
+  this->registers[AB1815_REG_ID0] = 0x18;
+  this->registers[AB1815_REG_ID1] = 0x15;
+  // Dates start at 2000-01-01
+  this->registers[0x04] = 0x01;
+  this->registers[0x05] = 0x01;
+
+  this->countdown_phase = 0;
+  this->watchdog_phase = 0;
+  this->watchdog_count = 0;
+  this->sleep_delay = 0;
+  this->sleeping = false;
+  this->resets = 0;
+  this->ms_remainder = 0;
+}
+
+// The byte behind a bus offset, RAM is paged in by XADS
+uint8_t* ab1815_simulator::map(uint8_t offset)
+{
+  if (offset >= 0x40)
+  {
+    uint8_t bank = this->registers[AB1815_EXTENTION_RAM] & 0x03;
+    return &this->ram[(bank << 6) | (offset - 0x40)];
+  }
+  return &this->registers[offset];
+}
+
+bool ab1815_simulator::key_allows(uint8_t offset)
+{
+  uint8_t key = this->registers[AB1815_REG_CONFIGURATION_KEY];
+  switch (offset)
+  {
+    case AB1815_REG_OSCILLATOR_CONTROL:
+      return key == 0xA1;
+    case AB1815_REG_TRICKLE_CONTROL:
+    case AB1815_REG_BREF_CONTROL:
+    case AB1815_REG_AFCTRL:
+    case AB1815_REG_BATMODE_IO:
+    case AB1815_REG_OUTPUT_CONTROL:
+      return key == 0x9D;
+    default:
+      return true;
+  }
+}
+
+void ab1815_simulator::bus_read(uint8_t offset, uint8_t* buf, uint8_t length)
+{
+  bool status_read = false;
+  for (uint8_t i = 0; i < length; i++)
+  {
+    uint8_t reg = (offset + i) & 0x7F;
+    buf[i] = *map(reg);
+    status_read |= (reg == AB1815_REG_STATUS);
+  }
+  if (status_read && (this->registers[AB1815_REG_CONTROL1] & SIM_CONTROL1_ARST))
+  {
+    this->registers[AB1815_REG_STATUS] &= ~SIM_STATUS_FLAGS;
+  }
+}
+
+void ab1815_simulator::bus_write(uint8_t offset, const uint8_t* buf, uint8_t length)
+{
+  for (uint8_t i = 0; i < length; i++)
+  {
+    write_register((offset + i) & 0x7F, buf[i]);
+  }
+}
+
+void ab1815_simulator::write_register(uint8_t offset, uint8_t value)
+{
+  if (offset >= 0x40)
+  {
+    *map(offset) = value;
+    return;
+  }
+
+  if (!key_allows(offset))
+  {
+    return;
+  }
+  switch (offset)
+  {
+    case 0x00: case 0x01: case 0x02: case 0x03:
+    case 0x04: case 0x05: case 0x06: case 0x07:
+      if (this->registers[AB1815_REG_CONTROL1] & SIM_CONTROL1_WRTC)
+      {
+        this->registers[offset] = value;
+      }
+      return;
+    case AB1815_REG_STATUS:
+      // Flags are cleared by writing 0, a 1 leaves them as they are
+      this->registers[offset] = (this->registers[offset] & value & SIM_STATUS_FLAGS) | (value & SIM_STATUS_CB);
+      return;
+    case AB1815_REG_SLEEP_CONTROL:
+      this->registers[offset] = value & ~SIM_SLEEP_SLST;
+      if (value & SIM_SLEEP_SLP)
+      {
+        if (irq())
+        {
+          // A pending interrupt rejects the sleep
+          this->registers[offset] &= ~SIM_SLEEP_SLP;
+        } else
+        {
+          // SLTO periods of 7.8 ms, in hundredths rounded up
+          this->sleep_delay = ((value & 0x07) * 78 + 99) / 100;
+          update_sleep();
+        }
+      }
+      return;
+    case AB1815_REG_COUNTDOWN_TIMER_CONTROL:
+      if (!(this->registers[offset] & SIM_COUNTDOWN_TE))
+      {
+        this->countdown_phase = 0;
+      }
+      this->registers[offset] = value;
+      return;
+    case AB1815_REG_WATCHDOG_TIMER:
+      this->registers[offset] = value;
+      this->watchdog_count = (value >> 2) & 0x1F;
+      this->watchdog_phase = 0;
+      return;
+    case AB1815_REG_CONFIGURATION_KEY:
+      if (value == 0x3C)
+      {
+        reset();
+        return;
+      }
+      this->registers[offset] = value;
+      return;
+    case 0x28: case 0x29: case 0x2A: case 0x2B: case 0x2C: case 0x2D: case 0x2E:
+    case AB1815_REG_ANALOG_STATUS:
+      // Read only
+      return;
+    default:
+      this->registers[offset] = value;
+      // The key only opens a single write to a protected register
+      if (offset == AB1815_REG_OSCILLATOR_CONTROL || offset == AB1815_REG_TRICKLE_CONTROL ||
+          offset == AB1815_REG_BREF_CONTROL || offset == AB1815_REG_AFCTRL ||
+          offset == AB1815_REG_BATMODE_IO || offset == AB1815_REG_OUTPUT_CONTROL)
+      {
+        this->registers[AB1815_REG_CONFIGURATION_KEY] = 0;
+      }
+      return;
+  }
+}
+
+static uint8_t sim_days_in_month(uint8_t month, uint8_t year)
+{
+  static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (month == 2 && (year % 4) == 0)
+  {
+    return 29;
+  }
+  return days[(month - 1) % 12];
+}
+
+void ab1815_simulator::tick_time()
+{
+  uint8_t* r = this->registers;
+  uint8_t hundredths = sim_bcd2bin(r[0x00]) + 1;
+  r[0x00] = sim_bin2bcd(hundredths % 100);
+  if (hundredths < 100)
+  {
+    return;
+  }
+  uint8_t second = sim_bcd2bin(r[0x01] & 0x7F) + 1;
+  r[0x01] = sim_bin2bcd(second % 60);
+  if (second < 60)
+  {
+    return;
+  }
+  uint8_t minute = sim_bcd2bin(r[0x02] & 0x7F) + 1;
+  r[0x02] = sim_bin2bcd(minute % 60);
+  if (minute < 60)
+  {
+    return;
+  }
+  uint8_t hour = sim_bcd2bin(r[0x03] & 0x3F) + 1;
+  r[0x03] = sim_bin2bcd(hour % 24);
+  if (hour < 24)
+  {
+    return;
+  }
+  r[0x07] = ((r[0x07] & 0x07) + 1) % 7;
+  uint8_t year = sim_bcd2bin(r[0x06]);
+  uint8_t month = sim_bcd2bin(r[0x05] & 0x1F);
+  uint8_t day = sim_bcd2bin(r[0x04] & 0x3F) + 1;
+  if (day <= sim_days_in_month(month, year))
+  {
+    r[0x04] = sim_bin2bcd(day);
+    return;
+  }
+  r[0x04] = 0x01;
+  if (month < 12)
+  {
+    r[0x05] = sim_bin2bcd(month + 1);
+    return;
+  }
+  r[0x05] = 0x01;
+  r[0x06] = sim_bin2bcd((year + 1) % 100);
+  if (year == 99 && (r[AB1815_REG_INTERRUPT_MASK] & SIM_INTERRUPT_CEB))
+  {
+    r[AB1815_REG_STATUS] ^= SIM_STATUS_CB;
+  }
+}
+
+void ab1815_simulator::check_alarm()
+{
+  static const uint8_t masks[7] = {0xFF, 0x7F, 0x7F, 0x3F, 0x3F, 0x1F, 0x07};
+  uint8_t* r = this->registers;
+  uint8_t rpt = (r[AB1815_REG_COUNTDOWN_TIMER_CONTROL] >> 2) & 0x07;
+  if (rpt == 0)
+  {
+    return;
+  }
+
+  // Fields compared per RPT: hundredths, seconds, minutes, hours, date,
+  // month, weekday (register 0x07 on the time side)
+  static const uint8_t compared[8] = {0x00, 0x3F, 0x1F, 0x4F, 0x0F, 0x07, 0x03, 0x01};
+  uint8_t fields = compared[rpt];
+  for (uint8_t field = 1; field < 7; field++)
+  {
+    if (!(fields & (1 << field)))
+    {
+      continue;
+    }
+    uint8_t time_reg = field == 6 ? 0x07 : field;
+    if ((r[time_reg] & masks[field]) != (r[AB1815_REG_ALARM_HUNDREDTHS + field] & masks[field]))
+    {
+      return;
+    }
+  }
+
+  uint8_t alarm = r[AB1815_REG_ALARM_HUNDREDTHS];
+  uint8_t now = r[0x00];
+  bool match;
+  if (alarm == 0xFF)
+  {
+    // Once per hundredth
+    match = true;
+  } else if ((alarm & 0xF0) == 0xF0)
+  {
+    // Once per tenth, on the hundredths digit
+    match = (now & 0x0F) == (alarm & 0x0F);
+  } else
+  {
+    match = now == alarm;
+  }
+  if (match)
+  {
+    r[AB1815_REG_STATUS] |= SIM_STATUS_ALM;
+  }
+}
+
+void ab1815_simulator::tick_countdown()
+{
+  uint8_t* r = this->registers;
+  uint8_t control = r[AB1815_REG_COUNTDOWN_TIMER_CONTROL];
+  if (!(control & SIM_COUNTDOWN_TE))
+  {
+    return;
+  }
+
+  // Ticks per minute for each TFS, 4096 Hz runs at 128 Hz on the RC oscillator
+  uint32_t rate;
+  switch (control & 0x03)
+  {
+    case 0:
+      rate = (r[AB1815_REG_OSCILLATOR_CONTROL] & SIM_OSCILLATOR_OSEL) ? 7680 : 245760;
+      break;
+    case 1:
+      rate = 3840;
+      break;
+    case 2:
+      rate = 60;
+      break;
+    default:
+      rate = 1;
+      break;
+  }
+
+  this->countdown_phase += rate;
+  while (this->countdown_phase >= 6000)
+  {
+    this->countdown_phase -= 6000;
+    if (r[AB1815_REG_COUNTDOWN_TIMER] != 0)
+    {
+      r[AB1815_REG_COUNTDOWN_TIMER]--;
+      continue;
+    }
+    r[AB1815_REG_STATUS] |= SIM_STATUS_TIM;
+    if (control & SIM_COUNTDOWN_TRPT)
+    {
+      r[AB1815_REG_COUNTDOWN_TIMER] = r[AB1815_REG_COUNTDOWN_TIMER_INITIAL];
+    } else
+    {
+      r[AB1815_REG_COUNTDOWN_TIMER_CONTROL] &= ~SIM_COUNTDOWN_TE;
+      this->countdown_phase = 0;
+      return;
+    }
+  }
+}
+
+void ab1815_simulator::tick_watchdog()
+{
+  if (this->watchdog_count == 0)
+  {
+    return;
+  }
+  static const uint16_t rates[4] = {960, 240, 60, 15};
+  uint8_t watchdog = this->registers[AB1815_REG_WATCHDOG_TIMER];
+  this->watchdog_phase += rates[watchdog & 0x03];
+  while (this->watchdog_phase >= 6000 && this->watchdog_count != 0)
+  {
+    this->watchdog_phase -= 6000;
+    if (--this->watchdog_count == 0)
+    {
+      this->registers[AB1815_REG_STATUS] |= SIM_STATUS_WDT;
+      if (watchdog & 0x80)
+      {
+        this->resets++;
+      }
+    }
+  }
+}
+
+void ab1815_simulator::update_sleep()
+{
+  uint8_t* sleep_control = &this->registers[AB1815_REG_SLEEP_CONTROL];
+  if (!(*sleep_control & SIM_SLEEP_SLP))
+  {
+    return;
+  }
+  if (irq())
+  {
+    // Any enabled interrupt wakes the chip up again
+    *sleep_control &= ~SIM_SLEEP_SLP;
+    this->sleeping = false;
+    return;
+  }
+  if (this->sleep_delay > 0)
+  {
+    this->sleep_delay--;
+    return;
+  }
+  if (!this->sleeping)
+  {
+    this->sleeping = true;
+    *sleep_control |= SIM_SLEEP_SLST;
+  }
+}
+
+void ab1815_simulator::advance_hundredths(uint32_t hundredths)
+{
+  while (hundredths-- > 0)
+  {
+    if (!(this->registers[AB1815_REG_CONTROL1] & SIM_CONTROL1_STOP))
+    {
+      tick_time();
+      check_alarm();
+    }
+    tick_countdown();
+    tick_watchdog();
+    update_sleep();
+  }
+}
+
+void ab1815_simulator::advance_ms(uint32_t ms)
+{
+  ms += this->ms_remainder;
+  this->ms_remainder = ms % 10;
+  advance_hundredths(ms / 10);
+}
+
+bool ab1815_simulator::irq()
+{
+  uint8_t status = this->registers[AB1815_REG_STATUS];
+  uint8_t enabled = this->registers[AB1815_REG_INTERRUPT_MASK] & 0x1F;
+  // The watchdog raises WIRQ when it is not steering nRST
+  if (!(this->registers[AB1815_REG_WATCHDOG_TIMER] & 0x80))
+  {
+    enabled |= SIM_STATUS_WDT;
+  }
+  return (status & enabled) != 0;
+}
@@ -0,0 +1,84 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+
+#ifndef AB1815_SIMULATOR_H_
+#define AB1815_SIMULATOR_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "AB1815_registers.h"
+
+// A host side model of the AB1815 register file, for testing and
+// benchmarking the driver without hardware. Build with
+// AB1815_TRANSPORT_SIMULATOR and the AB1815 class talks to
+// ab1815_simulator::shared, or to any simulator attached to its transport.
+//
+// Time only moves when advance_ms()/advance_hundredths() is called, so days
+// can be simulated in a fraction of a second. Modelled are: the time
+// counters with hundredths and calendar rollover (24 hour mode), alarm
+// matching for every RPT mode including the tenths/hundredths forms,
+// countdown timer expiry and reload, watchdog expiry, ARST clear-on-read of
+// the status register, the configuration key guarding 0x1C, 0x20, 0x21,
+// 0x26, 0x27 and 0x30, software reset, sleep entry/rejection/wake, and the
+// 256 byte RAM paged into 0x40 - 0x7F by XADS.
+class ab1815_simulator
+{
+  private:
+    uint32_t countdown_phase;
+    uint32_t watchdog_phase;
+    uint8_t watchdog_count;
+    uint8_t sleep_delay;
+    uint8_t ms_remainder;
+
+    uint8_t* map(uint8_t offset);
+    bool key_allows(uint8_t offset);
+    void write_register(uint8_t offset, uint8_t value);
+    void tick_time();
+    void check_alarm();
+    void tick_countdown();
+    void tick_watchdog();
+    void update_sleep();
+
+  public:
+    uint8_t registers[0x40];
+    uint8_t ram[256];
+    bool sleeping;
+    uint32_t resets;          // Watchdog expiries with WDS set
+
+#ifdef AB1815_TRANSPORT_SIMULATOR
+    static ab1815_simulator shared;
+#endif
+
+    ab1815_simulator();
+
+    // Power on state, the RAM is kept
+    void reset();
+
+    void bus_read(uint8_t offset, uint8_t* buf, uint8_t length);
+    void bus_write(uint8_t offset, const uint8_t* buf, uint8_t length);
+
+    void advance_hundredths(uint32_t hundredths);
+    void advance_ms(uint32_t ms);
+
+    // State of the nIRQ output, true when an enabled interrupt is pending
+    bool irq();
+};
+
+#endif /* AB1815_SIMULATOR_H_ */
@@ -0,0 +1,291 @@
+/**
+  *     An Abracon AB18X5 Real-Time Clock library for Arduino
+  *     Copyright (C) 2015 NigelB
+  *
+  *     This program is free software; you can redistribute it and/or modify
+  *     it under the terms of the GNU General Public License as published by
+  *     the Free Software Foundation; either version 2 of the License, or
+  *     (at your option) any later version.
+  *
+  *     This program is distributed in the hope that it will be useful,
+  *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *     GNU General Public License for more details.
+  *
+  *     You should have received a copy of the GNU General Public License along
+  *     with this program; if not, write to the Free Software Foundation, Inc.,
+  *     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+  **/
+
+#ifndef AB1815_TRANSPORT_H_
+#define AB1815_TRANSPORT_H_
+
+// Bus transports for the AB1815 class. The transport is picked at compile
+// time by defining one of the following before AB1815.h is included (or on
+// the compiler command line):
+//
+//   (nothing)              SPI through the global SPI object (AB1815)
+//   AB1815_TRANSPORT_I2C   I2C through the global Wire object (AB1805)
+//   AB1815_TRANSPORT_MOCK  In-memory register file, for host builds
+//   AB1815_TRANSPORT_SIMULATOR
+//                          Behavioural model of the chip (AB1815_simulator.h)
+//
+// Every transport has the same shape: a constructor taking the bus address,
+// begin(), and read()/write() returning true on success. They are plain
+// classes with inline members so read/write inline into the driver.
+
+#include "AB1815_registers.h"
+#include "Arduino.h"
+
+#if defined(AB1815_TRANSPORT_MOCK)
+
+class ab1815_mock_transport
+{
+  public:
+    uint8_t registers[0x80];
+    uint32_t transactions;
+    uint32_t bytes;
+
+    ab1815_mock_transport(uint16_t address)
+    {
+      (void)address;
+      memset(registers, 0, sizeof(registers));
+      // Identify as an AB1815 so that AB1815::init() succeeds
+      registers[AB1815_REG_ID0] = 0x18;
+      registers[AB1815_REG_ID1] = 0x15;
+      transactions = 0;
+      bytes = 0;
+    }
+
+    void begin()
+    {
+    }
+
+    bool read(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      if (offset + length > (uint16_t)sizeof(registers))
+      {
+        return false;
+      }
+      memcpy(buf, &registers[offset], length);
+      transactions++;
+      bytes += length + 1;
+      return true;
+    }
+
+    bool write(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      if (offset + length > (uint16_t)sizeof(registers))
+      {
+        return false;
+      }
+      memcpy(&registers[offset], buf, length);
+      transactions++;
+      bytes += length + 1;
+      return true;
+    }
+};
+
+typedef ab1815_mock_transport ab1815_transport_t;
+
+#elif defined(AB1815_TRANSPORT_SIMULATOR)
+
+#include "AB1815_simulator.h"
+
+class ab1815_simulator_transport
+{
+  public:
+    ab1815_simulator* simulator;
+    uint32_t transactions;
+    uint32_t bytes;
+
+    ab1815_simulator_transport(uint16_t address)
+    {
+      (void)address;
+      simulator = &ab1815_simulator::shared;
+      transactions = 0;
+      bytes = 0;
+    }
+
+    void begin()
+    {
+    }
+
+    // Point the transport at another simulated chip
+    void attach(ab1815_simulator* simulator)
+    {
+      this->simulator = simulator;
+    }
+
+    bool read(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      simulator->bus_read(offset, buf, length);
+      transactions++;
+      bytes += length + 1;
+      return true;
+    }
+
+    bool write(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      simulator->bus_write(offset, buf, length);
+      transactions++;
+      bytes += length + 1;
+      return true;
+    }
+};
+
+typedef ab1815_simulator_transport ab1815_transport_t;
+
+#elif defined(AB1815_TRANSPORT_I2C)
+
+#include "Wire.h"
+
+// Most Wire implementations buffer 32 bytes, including the offset byte
+#ifndef AB1815_I2C_CHUNK
+#define AB1815_I2C_CHUNK 30
+#endif
+
+class ab1815_i2c_transport
+{
+  private:
+    uint8_t address;
+
+  public:
+    ab1815_i2c_transport(uint16_t address)
+    {
+      this->address = address;
+    }
+
+    void begin()
+    {
+      Wire.begin();
+    }
+
+    bool read(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      while (length > 0)
+      {
+        uint8_t chunk = length > AB1815_I2C_CHUNK ? AB1815_I2C_CHUNK : length;
+        Wire.beginTransmission(address);
+        Wire.write(offset);
+        if (Wire.endTransmission(false) != 0)
+        {
+          return false;
+        }
+        if (Wire.requestFrom(address, chunk) != chunk)
+        {
+          return false;
+        }
+        for (uint8_t i = 0; i < chunk; i++)
+        {
+          buf[i] = Wire.read();
+        }
+        offset += chunk;
+        buf += chunk;
+        length -= chunk;
+      }
+      return true;
+    }
+
+    bool write(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      while (length > 0)
+      {
+        uint8_t chunk = length > AB1815_I2C_CHUNK ? AB1815_I2C_CHUNK : length;
+        Wire.beginTransmission(address);
+        Wire.write(offset);
+        Wire.write(buf, chunk);
+        if (Wire.endTransmission() != 0)
+        {
+          return false;
+        }
+        offset += chunk;
+        buf += chunk;
+        length -= chunk;
+      }
+      return true;
+    }
+};
+
+typedef ab1815_i2c_transport ab1815_transport_t;
+
+#else
+
+#include "SPI.h"
+
+class ab1815_spi_transport
+{
+  private:
+    uint16_t cs_pin;
+    SPISettings spiSettings = SPISettings((uint32_t)1000000, MSBFIRST, SPI_MODE0);
+
+    void spi_select_slave(bool select)
+    {
+      if (select)
+      {
+        digitalWrite(cs_pin, LOW);
+      } else
+      {
+        digitalWrite(cs_pin, HIGH);
+      }
+    }
+
+  public:
+    ab1815_spi_transport(uint16_t cs_pin)
+    {
+      this->cs_pin = cs_pin;
+    }
+
+    void begin()
+    {
+      pinMode(cs_pin, OUTPUT);
+      pinMode(SS, OUTPUT);
+      digitalWrite(cs_pin, HIGH);
+      SPI.begin();
+    }
+
+    bool read(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      // Address and payload go out as a single buffer transfer, which lets
+      // cores with FIFO/DMA backed SPI move the whole burst in one call.
+      uint8_t frame[length + 1];
+      memset(frame, 0, length + 1);
+      frame[0] = AB1815_SPI_READ(offset);
+      SPI.beginTransaction(spiSettings);
+      spi_select_slave(true);
+#if defined(ESP32)
+      SPI.transferBytes(frame, frame, length + 1);
+#else
+      SPI.transfer(frame, length + 1);
+#endif
+      spi_select_slave(false);
+      SPI.endTransaction();
+      memcpy(buf, &frame[1], length);
+      return true;
+    }
+
+    bool write(uint8_t offset, uint8_t* buf, uint8_t length)
+    {
+      // The buffer transfer overwrites its input with the received bytes, so
+      // the payload is copied into a frame behind the address byte.
+      uint8_t frame[length + 1];
+      frame[0] = AB1815_SPI_WRITE(offset);
+      memcpy(&frame[1], buf, length);
+      SPI.beginTransaction(spiSettings);
+      spi_select_slave(true);
+#if defined(ESP32)
+      SPI.writeBytes(frame, length + 1);
+#else
+      SPI.transfer(frame, length + 1);
+#endif
+      spi_select_slave(false);
+      SPI.endTransaction();
+      return true;
+    }
+};
+
+typedef ab1815_spi_transport ab1815_transport_t;
+
+#endif
+
+#endif /* AB1815_TRANSPORT_H_ */
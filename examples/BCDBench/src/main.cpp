@@ -0,0 +1,169 @@
+/*
+    An Abracon AB18X5 Real-Time Clock library for Arduino
+    Copyright (C) 2015 NigelB
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+// Compares the whole block BCD conversions used for the time and alarm
+// registers (ab1815_bcd2bin_block/ab1815_bin2bcd_block) against converting
+// one register at a time with bcd2bin/bin2bcd. Both must give the same
+// result for every block; the time each takes is printed, on an AVR board
+// (table lookup) as well as on a PC (one 64 bit word, see examples/host),
+// where a mismatch makes the program exit with 1.
+
+#include "main.h"
+
+#define BENCH_BLOCKS 32
+#ifdef ARDUINO
+#define BENCH_ROUNDS 100
+#else
+#define BENCH_ROUNDS 100000UL
+#endif
+
+FILE* debug;
+
+static uint8_t bench_bin[BENCH_BLOCKS][8];
+static uint8_t bench_bcd[BENCH_BLOCKS][8];
+static volatile uint8_t bench_sink;
+
+static void bcd2bin_fields(const uint8_t* bcd, uint8_t* bin, uint64_t mask)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        bin[i] = bcd2bin(bcd[i] & (uint8_t)(mask >> (8 * i)));
+    }
+}
+
+static void bin2bcd_fields(const uint8_t* bin, uint8_t* bcd)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        bcd[i] = bin2bcd(bin[i]);
+    }
+}
+
+// Blocks spread over 2000 - 2099 at different times of day
+static void fill_blocks()
+{
+    for (uint8_t i = 0; i < BENCH_BLOCKS; i++)
+    {
+        ab1815_epoch_to_block(946684800UL + i * 98765432UL, bench_bin[i]);
+        bench_bin[i][0] = i * 3;
+        bin2bcd_fields(bench_bin[i], bench_bcd[i]);
+    }
+}
+
+// Returns the number of blocks for which the two conversions disagree
+static uint8_t compare()
+{
+    uint8_t mismatches = 0;
+    for (uint8_t i = 0; i < BENCH_BLOCKS; i++)
+    {
+        uint8_t fields[8];
+        uint8_t block[8];
+        bcd2bin_fields(bench_bcd[i], fields, AB1815_TIME_BCD_MASK);
+        ab1815_bcd2bin_block(bench_bcd[i], block, AB1815_TIME_BCD_MASK);
+        bool equal = memcmp(fields, block, 8) == 0;
+        bcd2bin_fields(bench_bcd[i], fields, AB1815_ALARM_BCD_MASK);
+        ab1815_bcd2bin_block(bench_bcd[i], block, AB1815_ALARM_BCD_MASK);
+        equal &= memcmp(fields, block, 8) == 0;
+        bin2bcd_fields(bench_bin[i], fields);
+        ab1815_bin2bcd_block(bench_bin[i], block);
+        equal &= memcmp(fields, block, 8) == 0;
+        if (!equal)
+        {
+            fprintf(debug, "# block %u differs\r\n", i);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static uint32_t time_bcd2bin(void (*convert)(const uint8_t* bcd, uint8_t* bin, uint64_t mask))
+{
+    uint8_t bin[8];
+    uint32_t start = micros();
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (uint8_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            convert(bench_bcd[i], bin, AB1815_TIME_BCD_MASK);
+            bench_sink = bin[i & 7];
+        }
+    }
+    return micros() - start;
+}
+
+static uint32_t time_bin2bcd(void (*convert)(const uint8_t* bin, uint8_t* bcd))
+{
+    uint8_t bcd[8];
+    uint32_t start = micros();
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (uint8_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            convert(bench_bin[i], bcd);
+            bench_sink = bcd[i & 7];
+        }
+    }
+    return micros() - start;
+}
+
+// Returns true when the conversions disagree
+static bool run_bench()
+{
+    fill_blocks();
+    uint8_t mismatches = compare();
+
+    uint32_t conversions = (uint32_t)BENCH_ROUNDS * BENCH_BLOCKS;
+    fprintf(debug, "# %lu conversions of 8 registers\r\n", (unsigned long)conversions);
+    fprintf(debug, "# bcd2bin per field %lu us, block %lu us\r\n",
+            (unsigned long)time_bcd2bin(bcd2bin_fields),
+            (unsigned long)time_bcd2bin(ab1815_bcd2bin_block));
+    fprintf(debug, "# bin2bcd per field %lu us, block %lu us\r\n",
+            (unsigned long)time_bin2bcd(bin2bcd_fields),
+            (unsigned long)time_bin2bcd(ab1815_bin2bcd_block));
+    return mismatches != 0;
+}
+
+#ifdef ARDUINO
+int debug_putchar(char ch, FILE* stream)
+{
+    Serial.write(ch) ;
+    return (0) ;
+}
+
+void setup() {
+    Serial.begin(9600);
+    debug = new FILE();
+    fdev_setup_stream (debug, debug_putchar, NULL, _FDEV_SETUP_WRITE);
+
+    Serial.println(run_bench() ? "MISMATCH" : "OK");
+}
+
+void loop() {
+}
+#else
+int main()
+{
+    debug = stdout;
+
+    bool mismatch = run_bench();
+    printf("%s\n", mismatch ? "MISMATCH" : "OK");
+    return mismatch ? 1 : 0;
+}
+#endif
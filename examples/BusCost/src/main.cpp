@@ -0,0 +1,169 @@
+/*
+    An Abracon AB18X5 Real-Time Clock library for Arduino
+    Copyright (C) 2015 NigelB
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+// Measures the bus cost of the common AB1815 operations and compares it
+// against a budget. Build with AB1815_ENABLE_STATS (see platformio.ini); a
+// change to the library which makes any operation use more SPI transactions
+// than its budget prints REGRESSION, which matters on battery powered nodes
+// where every transfer keeps the MCU and the bus awake.
+//
+// The same file builds on a PC against the simulated clock (see
+// examples/host), where a regression makes the program exit with 1.
+
+#include "main.h"
+
+FILE* debug;
+AB1815 * ab1815_clock;
+
+struct bus_cost_t
+{
+    const char* name;
+    void (*operation)(AB1815* clock);
+    uint32_t budget;        // Maximum SPI transactions
+};
+
+static ab1815_tmElements_t bench_time;
+
+static void bench_get(AB1815* clock)
+{
+    clock->get();
+}
+
+static void bench_set(AB1815* clock)
+{
+    clock->set(1600000000UL);
+}
+
+static void bench_set_alarm(AB1815* clock)
+{
+    breakTime(1600000060UL, bench_time);
+    clock->set_alarm(&bench_time, ab1815_alarm_repeat_mode(4));
+}
+
+static void bench_get_alarm(AB1815* clock)
+{
+    enum ab1815_alarm_repeat_mode alarm_mode;
+    clock->get_alarm(&bench_time, &alarm_mode);
+}
+
+static void bench_hex_dump(AB1815* clock)
+{
+    clock->hex_dump(debug);
+}
+
+static void bench_get_id(AB1815* clock)
+{
+    clock->get_id(&clock->id);
+}
+
+// Budgets are the transaction counts of the current library, lower them
+// when an operation gets cheaper.
+static const bus_cost_t bus_costs[] = {
+    {"get", bench_get, 1},
+    {"set", bench_set, 1},
+    {"set_alarm", bench_set_alarm, 3},
+    {"get_alarm", bench_get_alarm, 2},
+    {"hex_dump", bench_hex_dump, 16},
+    {"get_id", bench_get_id, 1},
+    {"initialize_clock", initialize_clock, 9},
+};
+
+// Returns true when any operation went over its budget
+static bool measure_bus_costs()
+{
+    bool regression = false;
+    for (uint8_t i = 0; i < sizeof(bus_costs) / sizeof(bus_costs[0]); i++)
+    {
+        const bus_cost_t* cost = &bus_costs[i];
+        ab1815_clock->reset_stats();
+        uint32_t start = micros();
+        cost->operation(ab1815_clock);
+        uint32_t elapsed = micros() - start;
+        ab1815_bus_stats_t* stats = ab1815_clock->get_stats();
+
+        bool over = stats->transactions > cost->budget;
+        regression |= over;
+        fprintf(debug, "# %s: %lu transactions (budget %lu) %lu bytes %lu us%s\r\n",
+                cost->name,
+                (unsigned long)stats->transactions,
+                (unsigned long)cost->budget,
+                (unsigned long)(stats->bytes_read + stats->bytes_written),
+                (unsigned long)elapsed,
+                over ? " OVER BUDGET" : "");
+    }
+    return regression;
+}
+
+#ifdef ARDUINO
+int debug_putchar(char ch, FILE* stream)
+{
+    Serial.write(ch) ;
+    return (0) ;
+}
+
+void setup() {
+    Serial.begin(9600);
+    debug = new FILE();
+    fdev_setup_stream (debug, debug_putchar, NULL, _FDEV_SETUP_WRITE);
+    ab1815_clock = new AB1815(10);
+
+    Serial.println(measure_bus_costs() ? "REGRESSION" : "OK");
+}
+
+void loop() {
+}
+#else
+int main()
+{
+    debug = stdout;
+    ab1815_clock = new AB1815(10);
+
+    bool regression = measure_bus_costs();
+    printf("%s\n", regression ? "REGRESSION" : "OK");
+    return regression ? 1 : 0;
+}
+#endif
+
+void initialize_clock(AB1815* clock)
+{
+    oscillator_control_t oscillator_control;
+    clock->get_oscillator_control(&oscillator_control);
+    oscillator_control.fields.OSEL = 1;
+    oscillator_control.fields.PWGT = 1;
+    clock->set_oscillator_control(&oscillator_control);
+
+    clock->clear_hundrdeds();
+
+    struct control1_t control1;
+    clock->get_control1(&control1);
+    control1.fields._12_24 = 0;
+    control1.fields.PWR2 = 1;
+    clock->set_control1(&control1);
+
+    inturrupt_mask_t int_mask;
+    clock->get_interrupt_mask(&int_mask);
+    int_mask.fields.AIE = 1;
+    int_mask.fields.IM = ab1815_interrupt_im_level;
+    clock->set_interrupt_mask(&int_mask);
+
+    control2_t control2;
+    control2.value = 0;
+    control2.fields.OUT2S = ab1815_psw_SLEEP;
+    clock->set_control2(&control2);
+}
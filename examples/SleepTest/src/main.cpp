@@ -22,6 +22,18 @@
 FILE* debug;
 AB1815 * ab1815_clock;
 
+// OSEL = 1: the RC oscillator instead of the XTAL.
+// PWGT = 1: disable the I/O interface during sleep to ensure the clock is not
+//           corrupted by floating pins and what not.
+// 24 hour mode, nIRQ2 as the power switch opened during sleep, and the alarm
+// interrupt as a logic level (opposed to a pulse).
+AB1815_DECLARE_PROFILE(psw_profile, ab1815_profile()
+    .rc_oscillator()
+    .power_gate_interface(true)
+    .hour_24()
+    .psw_sleep()
+    .alarm_interrupt(ab1815_interrupt_im_level));
+
 int debug_putchar(char ch, FILE* stream)
 {
     Serial.write(ch) ;
@@ -65,57 +77,17 @@ void loop() {
 
 void initialize_clock(AB1815* clock)
 {
-    oscillator_control_t oscillator_control;
-    clock->get_oscillator_control(&oscillator_control);
-    Serial.print("# retrieved oscillator_control: ");
-    Serial.println(oscillator_control.value, HEX);
-
-//  OSEL = 1 when using RC oscillator instead of XTAL
-	oscillator_control.fields.OSEL = 1;
-
-//  Disable I/O Interface during sleep to ensure the clock it not corrupted
-//  by floating pins and what not.
-    oscillator_control.fields.PWGT = 1;
-    Serial.print("# set oscillator_control: ");
-    Serial.println(oscillator_control.value, HEX);
-
-    clock->set_oscillator_control(&oscillator_control);
+    bool applied;
+    if (psw_profile.apply_if_changed(clock, &applied) != ab1815_status_e_OK)
+    {
+        Serial.println("# Clock configuration failed");
+        return;
+    }
+    Serial.println(applied ? "# Clock configured" : "# Clock configuration unchanged");
 
 //  Hundredths don't seem to tick over when using the RC clock source
 //  So I clear them
     clock->clear_hundrdeds();
-
-
-    struct control1_t control1;
-    clock->get_control1(&control1);
-
-//	0 is 24 Hour Mode
-    control1.fields._12_24 = 0;
-
-//  1 is Power Switch Mode
-    control1.fields.PWR2 = 1;
-    clock->set_control1(&control1);
-
-
-    inturrupt_mask_t int_mask;
-    clock->get_interrupt_mask(&int_mask);
-
-//  Alarm Interrupt Enable = true
-    int_mask.fields.AIE = 1;
-
-//  Set Interrupt Mode to be a Logic Level (opposed to a pulse)
-    int_mask.fields.IM = ab1815_interrupt_im_level;
-    clock->set_interrupt_mask(&int_mask);
-
-    control2_t control2;
-
-//  Set NIRQ Pin to output NIRQ (since AIE is enabled)
-//    control2.fields.OUT1S = ab1815_fout_nIRQ_or_OUT;
-
-//  Set NIRQ2 pin to be power switched sleep
-    control2.fields.OUT2S = ab1815_psw_SLEEP;
-    clock->set_control2(&control2);
-
 }
 
 void do_psw_sleep(AB1815 *ab1815_clock, time_t wake_at)
@@ -143,23 +115,14 @@ void do_psw_sleep(AB1815 *ab1815_clock, time_t wake_at)
             alarm.Second
     );
 
-    status_t status;
-    ab1815_clock->get_status(&status);
-    status.fields.ALM = 0;
-    ab1815_clock->set_status(&status);
-
-
-    ab1815_clock->set_alarm(&alarm, ab1815_alarm_repeat_once_per_day);
-    ab1815_clock->hex_dump(debug);
-    delay(100);
-
-    // Set the sleep bit and wait ~8ms (SLTO=1) before enabling the PSW switch
-    // and powering down you microcontroller.
-    sleep_control_t sleep_control;
-    ab1815_clock->get_sleep_control(&sleep_control);
-    sleep_control.fields.SLP = 1;
-    sleep_control.fields.SLTO = 1;
-    ab1815_clock->set_sleep_control(&sleep_control);
+    // Clear the interrupt flags, program the alarm and set the sleep bit.
+    // SLTO is picked so the clock waits at least 8ms before enabling the
+    // PSW switch and powering down your microcontroller.
+    if (ab1815_clock->sleep_until(wake_at, 8, false) != ab1815_status_e_OK)
+    {
+        Serial.println("Sleep Rejected");
+        return;
+    }
 
     Serial.println("Sleep Sent");
     delay(3000);
@@ -22,6 +22,7 @@
 
 #include "Arduino.h"
 #include "AB1815.h"
+#include "AB1815_profile.h"
 #include "SPI.h"
 
 #ifdef __cplusplus
@@ -0,0 +1,99 @@
+/*
+    An Abracon AB18X5 Real-Time Clock library for Arduino
+    Copyright (C) 2015 NigelB
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+// Just enough of the Arduino core to build the library and the host
+// programs of the examples on a PC, see the Makefile next to this file.
+// The clock is simulated (AB1815_TRANSPORT_SIMULATOR), so pins and
+// interrupts do nothing.
+
+#ifndef AB1815EXAMPLES_HOST_ARDUINO_H
+#define AB1815EXAMPLES_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+inline void pinMode(uint16_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+inline void digitalWrite(uint16_t pin, uint8_t value)
+{
+  (void)pin;
+  (void)value;
+}
+
+inline int digitalRead(uint16_t pin)
+{
+  (void)pin;
+  return HIGH;
+}
+
+inline int digitalPinToInterrupt(int pin)
+{
+  return pin;
+}
+
+inline void attachInterrupt(int interrupt, void (*isr)(void), int mode)
+{
+  (void)interrupt;
+  (void)isr;
+  (void)mode;
+}
+
+inline void noInterrupts()
+{
+}
+
+inline void interrupts()
+{
+}
+
+inline unsigned long micros()
+{
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis()
+{
+  return micros() / 1000;
+}
+
+inline void delay(unsigned long ms)
+{
+  (void)ms;
+}
+
+#endif //AB1815EXAMPLES_HOST_ARDUINO_H
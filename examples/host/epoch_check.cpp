@@ -0,0 +1,99 @@
+/*
+    An Abracon AB18X5 Real-Time Clock library for Arduino
+    Copyright (C) 2015 NigelB
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+// Checks ab1815_epoch_to_block() and ab1815_block_to_epoch() against
+// breakTime() and makeTime() of the Time library for every day from
+// 2000-01-01 to 2100-12-31, at a different time of day each day, so every
+// leap day, the leap year 2000 and the non leap year 2100 are covered.
+// Prints the time per conversion of both and exits with 1 on a mismatch.
+
+#include "Arduino.h"
+#include "AB1815.h"
+
+#define FIRST_DAY 10957UL       // 2000-01-01
+#define LAST_DAY 47846UL        // 2100-12-31
+#define LEAP_DAYS 25            // 2000 - 2096
+
+static uint32_t mismatches = 0;
+
+static void expect(bool equal, time_t epoch, const char* what)
+{
+  if (!equal)
+  {
+    if (mismatches < 10)
+    {
+      printf("# %lu: %s differs\n", (unsigned long)epoch, what);
+    }
+    mismatches++;
+  }
+}
+
+int main()
+{
+  uint32_t leap_days = 0;
+  for (uint32_t day = FIRST_DAY; day <= LAST_DAY; day++)
+  {
+    time_t epoch = (time_t)day * SECS_PER_DAY + (day * 7919UL) % SECS_PER_DAY;
+    tmElements_t tm;
+    uint8_t bin[8];
+    breakTime(epoch, tm);
+    ab1815_epoch_to_block(epoch, bin);
+
+    expect(bin[1] == tm.Second && bin[2] == tm.Minute && bin[3] == tm.Hour, epoch, "epoch_to_block time");
+    expect(bin[4] == tm.Day && bin[5] == tm.Month && bin[6] == tmYearToY2k(tm.Year), epoch, "epoch_to_block date");
+    expect(bin[7] == tm.Wday, epoch, "epoch_to_block weekday");
+    expect(ab1815_block_to_epoch(bin) == epoch, epoch, "block_to_epoch");
+    expect(makeTime(tm) == epoch, epoch, "makeTime");
+    if (tm.Month == 2 && tm.Day == 29)
+    {
+      leap_days++;
+    }
+  }
+  if (leap_days != LEAP_DAYS)
+  {
+    printf("# %lu leap days instead of %d\n", (unsigned long)leap_days, LEAP_DAYS);
+    mismatches++;
+  }
+
+  // Same inputs for both, the sums keep the calls from being optimized away
+  uint8_t bin[8];
+  tmElements_t tm;
+  uint32_t sum = 0;
+  uint32_t start = micros();
+  for (uint32_t day = FIRST_DAY; day <= LAST_DAY; day++)
+  {
+    ab1815_epoch_to_block((time_t)day * SECS_PER_DAY, bin);
+    sum += ab1815_block_to_epoch(bin);
+  }
+  uint32_t block_us = micros() - start;
+  start = micros();
+  for (uint32_t day = FIRST_DAY; day <= LAST_DAY; day++)
+  {
+    breakTime((time_t)day * SECS_PER_DAY, tm);
+    sum -= makeTime(tm);
+  }
+  uint32_t tm_us = micros() - start;
+
+  printf("# %lu days, block %lu us, breakTime/makeTime %lu us%s\n",
+         LAST_DAY - FIRST_DAY + 1, (unsigned long)block_us, (unsigned long)tm_us,
+         sum == 0 ? "" : " (results differ)");
+  printf("%s\n", mismatches == 0 && sum == 0 ? "OK" : "MISMATCH");
+  return mismatches == 0 && sum == 0 ? 0 : 1;
+}